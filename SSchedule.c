@@ -9,57 +9,246 @@
 
 //
 
+//
+// A block is just its first and last second, 16 bytes in all:  the extreme
+// int64_t values are reserved to mean "no lower bound" and "no upper bound", so
+// bounds compare as plain integers with an unbounded start sorting first and an
+// unbounded end last.  (A bounded time range can't start at INT64_MIN or end at
+// INT64_MAX; it is read as unbounded on that side.)
+//
 typedef struct SScheduleBlock {
-    STimeRangeRef           period;
-    struct SScheduleBlock   *link;
+    int64_t         start, end;
 } SScheduleBlock;
 
+#define SSCHEDULE_BLOCK_NO_START        INT64_MIN
+#define SSCHEDULE_BLOCK_NO_END          INT64_MAX
+
+#define SSCHEDULE_BLOCK_HAS_START(B)    ((B)->start != SSCHEDULE_BLOCK_NO_START)
+#define SSCHEDULE_BLOCK_HAS_END(B)      ((B)->end != SSCHEDULE_BLOCK_NO_END)
+
 //
 
-static SScheduleBlock   *__SScheduleBlockFreeList = NULL;
+#ifndef SSCHEDULE_BLOCKS_MIN_CAPACITY
+#define SSCHEDULE_BLOCKS_MIN_CAPACITY 64
+#endif
+
+//
 
-SScheduleBlock*
-SScheduleBlockAlloc(void)
+bool
+__SScheduleBlockInitWithValue(
+    SScheduleBlock          *theBlock,
+    const STimeRangeValue   *aValue
+)
 {
-    SScheduleBlock  *newBlock = NULL;
+    if ( ! STimeRangeValueIsValid(aValue) ) return false;
+    theBlock->start = (aValue->flags & kSTimeRangeValueHasLowerBound) ? aValue->start : SSCHEDULE_BLOCK_NO_START;
+    theBlock->end = (aValue->flags & kSTimeRangeValueHasUpperBound) ? aValue->end : SSCHEDULE_BLOCK_NO_END;
+    return true;
+}
 
-    if ( __SScheduleBlockFreeList ) {
-        newBlock = __SScheduleBlockFreeList;
-        __SScheduleBlockFreeList = newBlock->link;
-    } else {
-        newBlock = malloc(sizeof(SScheduleBlock));
+bool
+__SScheduleBlockInitWithTimeRange(
+    SScheduleBlock  *theBlock,
+    STimeRangeRef   aTimeRange
+)
+{
+    STimeRangeValue aValue = STimeRangeGetValue(aTimeRange);
+    
+    return __SScheduleBlockInitWithValue(theBlock, &aValue);
+}
+
+//
+
+STimeRangeValue
+__SScheduleBlockGetValue(
+    const SScheduleBlock    *theBlock
+)
+{
+    STimeRangeValue         outValue = STimeRangeValueInfinite;
+    
+    if ( SSCHEDULE_BLOCK_HAS_START(theBlock) ) {
+        outValue.start = theBlock->start;
+        outValue.flags |= kSTimeRangeValueHasLowerBound;
     }
-    if ( newBlock ) {
-        newBlock->period = NULL;
-        newBlock->link = NULL;
+    if ( SSCHEDULE_BLOCK_HAS_END(theBlock) ) {
+        outValue.end = theBlock->end;
+        outValue.flags |= kSTimeRangeValueHasUpperBound;
     }
-    return newBlock;
+    return outValue;
+}
+
+//
+
+STimeRangeRef
+__SScheduleBlockCreateTimeRange(
+    const SScheduleBlock    *theBlock
+)
+{
+    STimeRangeValue         theValue = __SScheduleBlockGetValue(theBlock);
+    
+    return STimeRangeCreateWithValue(&theValue);
+}
+
+//
+
+const char*
+__SScheduleBlockFormat(
+    const SScheduleBlock    *theBlock,
+    char                    *buffer,
+    size_t                  bufferSize
+)
+{
+    STimeRangeValue         theValue = __SScheduleBlockGetValue(theBlock);
+    
+    STimeRangeValueFormat(&theValue, buffer, bufferSize);
+    return buffer;
+}
+
+//
+
+bool
+__SScheduleBlockIsEqual(
+    const SScheduleBlock    *aBlock,
+    const SScheduleBlock    *anotherBlock
+)
+{
+    return ( (aBlock->start == anotherBlock->start) && (aBlock->end == anotherBlock->end) );
+}
+
+//
+
+bool
+__SScheduleBlockClipToBlock(
+    SScheduleBlock          *clipThis,
+    const SScheduleBlock    *toThis
+)
+{
+    //
+    // Narrow clipThis to the portion inside toThis; returns false if nothing
+    // is left:
+    //
+    if ( clipThis->start < toThis->start ) clipThis->start = toThis->start;
+    if ( clipThis->end > toThis->end ) clipThis->end = toThis->end;
+    return ( clipThis->start <= clipThis->end );
+}
+
+//
+
+int
+__SScheduleBlockCmpStart(
+    const SScheduleBlock    *lhs,
+    const SScheduleBlock    *rhs
+)
+{
+    //
+    // Order two blocks by start time (an unbounded start sorts first):
+    //
+    if ( lhs->start < rhs->start ) return -1;
+    if ( lhs->start > rhs->start ) return +1;
+    return 0;
+}
+
+//
+
+bool
+__SScheduleBlockDoesTouch(
+    const SScheduleBlock    *earlier,
+    const SScheduleBlock    *later
+)
+{
+    //
+    // Given two blocks ordered by start time, do they overlap or sit end-to-end
+    // with no seconds between them?
+    //
+    if ( ! SSCHEDULE_BLOCK_HAS_END(earlier) ) return true;
+    return ( later->start <= earlier->end + 1 );
 }
 
 //
 
 void
-SScheduleBlockDealloc(
-    SScheduleBlock  *theBlock
+__SScheduleBlockAbsorb(
+    SScheduleBlock          *earlier,
+    const SScheduleBlock    *later
 )
 {
-    if ( theBlock->period ) {
-        STimeRangeRelease(theBlock->period);
-        theBlock->period = NULL;
-    }
-    theBlock->link = __SScheduleBlockFreeList;
-    __SScheduleBlockFreeList = theBlock;
+    //
+    // Extend earlier to also cover later (the two must touch):
+    //
+    if ( later->end > earlier->end ) earlier->end = later->end;
 }
 
 //
 
+//
+// A schedule keeps the SQLite connection to the file it was last loaded from or
+// saved to open for its lifetime, along with every statement prepared on it, so
+// a command line that loads, saves, and saves again opens the file just once:
+//
+enum {
+    kSScheduleStatementGetUserVersion = 0,
+    kSScheduleStatementCountTables,
+    kSScheduleStatementGetDataVersion,
+    kSScheduleStatementSelectPeriodV1,
+    kSScheduleStatementSelectPeriod,
+    kSScheduleStatementSelectBlocksV1,
+    kSScheduleStatementSelectBlocks,
+    kSScheduleStatementUpdatePeriod,
+    kSScheduleStatementInsertBlock,
+    kSScheduleStatementUpdateBlock,
+    kSScheduleStatementDeleteBlock,
+    kSScheduleStatementDeleteAllBlocks,
+    kSScheduleStatementMax
+};
+
+const char* __SScheduleStatementSQL[kSScheduleStatementMax] = {
+        "PRAGMA user_version",
+        "SELECT count(*) FROM sqlite_master",
+        "PRAGMA data_version",
+        "SELECT period FROM schedule LIMIT 1",
+        "SELECT start, end FROM schedule LIMIT 1",
+        "SELECT block_id, period FROM blocks ORDER BY block_id",
+        "SELECT block_id, start, end FROM blocks ORDER BY block_id",
+        "UPDATE schedule SET start = ?, end = ?",
+        "INSERT INTO blocks (start, end) VALUES (?, ?)",
+        "UPDATE blocks SET start = ?, end = ? WHERE block_id = ?",
+        "DELETE FROM blocks WHERE block_id = ?",
+        "DELETE FROM blocks"
+    };
+
+//
+// The rows of the blocks table as of the last load or save:  each block's value
+// and row id, sorted like the schedule's blocks.  Saving over the connection they
+// came from, if no one else has written to the file since (per its data_version),
+// diffs the blocks against these so only the rows that changed are touched.
+//
+typedef struct SScheduleStoredBlock {
+    SScheduleBlock  block;
+    int64_t         rowId;
+} SScheduleStoredBlock;
+
 typedef struct SSchedule {
-    uint32_t        refcount;
-    STimeRangeRef   period;
-    unsigned int    blockCount;
-    SScheduleBlock  *blocks;
-    const char      *lastErrorMessage;
-    char            staticErrorMessageBuffer[64];
+    SRefCount               refcount;
+    STimeRangeRef           period;
+    SScheduleBlock          periodBlock;
+    unsigned int            blockCount, blockCapacity, finger;
+    SScheduleBlock          *blocks;
+    uint64_t                *gapIndex;
+    unsigned int            gapIndexLeafCount;
+    bool                    isGapIndexValid;
+    STimeRangeRef           *blockRanges;
+    unsigned int            blockRangesCount, blockRangesCapacity;
+    sqlite3                 *dbHandle;
+    char                    *dbFilepath;
+    struct stat             dbFileInfo;
+    bool                    isDbImmutable;
+    sqlite3_stmt            *dbStatements[kSScheduleStatementMax];
+    bool                    hasStoredBlocks;
+    SScheduleStoredBlock    *storedBlocks;
+    unsigned int            storedBlockCount;
+    int64_t                 storedDataVersion;
+    const char              *lastErrorMessage;
+    char                    staticErrorMessageBuffer[64];
 } SSchedule;
 
 //
@@ -70,10 +259,23 @@ __SScheduleAlloc(void)
     SSchedule       *newSchedule = malloc(sizeof(SSchedule));
 
     if ( newSchedule ) {
-        newSchedule->refcount = 1;
+        SREFCOUNT_INIT(newSchedule->refcount, 1);
         newSchedule->period = NULL;
-        newSchedule->blockCount = 0;
+        newSchedule->blockCount = newSchedule->blockCapacity = newSchedule->finger = 0;
         newSchedule->blocks = NULL;
+        newSchedule->gapIndex = NULL;
+        newSchedule->gapIndexLeafCount = 0;
+        newSchedule->isGapIndexValid = false;
+        newSchedule->blockRanges = NULL;
+        newSchedule->blockRangesCount = newSchedule->blockRangesCapacity = 0;
+        newSchedule->dbHandle = NULL;
+        newSchedule->dbFilepath = NULL;
+        memset(&newSchedule->dbFileInfo, 0, sizeof(newSchedule->dbFileInfo));
+        newSchedule->isDbImmutable = false;
+        memset(newSchedule->dbStatements, 0, sizeof(newSchedule->dbStatements));
+        newSchedule->hasStoredBlocks = false;
+        newSchedule->storedBlocks = NULL;
+        newSchedule->storedBlockCount = 0;
         newSchedule->lastErrorMessage = NULL;
     }
     return newSchedule;
@@ -81,1009 +283,2873 @@ __SScheduleAlloc(void)
 
 //
 
-void
-__SScheduleDealloc(
-    SSchedule   *aSchedule
+bool
+__SScheduleSetPeriod(
+    SSchedule       *aSchedule,
+    STimeRangeRef   period
 )
 {
-    SScheduleBlock  *block = aSchedule->blocks;
-
-    while ( block ) {
-        SScheduleBlock  *next = block->link;
-
-        SScheduleBlockDealloc(block);
-        block = next;
-    }
-    if ( aSchedule->period ) STimeRangeRelease(aSchedule->period);
-    if ( aSchedule->lastErrorMessage && (aSchedule->lastErrorMessage != aSchedule->staticErrorMessageBuffer) ) free((void*)aSchedule->lastErrorMessage);
-    free((void*)aSchedule);
+    if ( ! __SScheduleBlockInitWithTimeRange(&aSchedule->periodBlock, period) ) return false;
+    aSchedule->period = STimeRangeRetain(period);
+    return true;
 }
 
 //
 
-void
-__SScheduleDebug(
-    SSchedule   *aSchedule
+bool
+__SScheduleGrowBlocks(
+    SSchedule       *aSchedule,
+    unsigned int    minCapacity
 )
 {
-    if ( aSchedule ) {
-        SScheduleBlock  *block = aSchedule->blocks;
-        unsigned int    i = 0;
-
-        printf(
-                "SSchedule@%p(%u) {\n"
-                "  period: %s\n"
-                "  blockCount: %u\n",
-                aSchedule, aSchedule->refcount,
-                STimeRangeGetCString(aSchedule->period),
-                aSchedule->blockCount
-            );
-        while ( block ) {
-            printf("    %d : %s\n", i++, STimeRangeGetCString(block->period));
-            block = block->link;
-        }
-        printf(
-                "  lastErrorMessage: %s\n"
-                "}\n",
-                ( aSchedule->lastErrorMessage ? aSchedule->lastErrorMessage : "<none>" )
-            );
+    if ( minCapacity > aSchedule->blockCapacity ) {
+        unsigned int    newCapacity = aSchedule->blockCapacity ? aSchedule->blockCapacity : SSCHEDULE_BLOCKS_MIN_CAPACITY;
+        SScheduleBlock  *newBlocks;
+
+        while ( newCapacity < minCapacity ) newCapacity *= 2;
+        newBlocks = realloc(aSchedule->blocks, newCapacity * sizeof(SScheduleBlock));
+        if ( ! newBlocks ) return false;
+        aSchedule->blocks = newBlocks;
+        aSchedule->blockCapacity = newCapacity;
     }
+    return true;
 }
 
 //
 
-#include <stdarg.h>
-
 void
-__SScheduleSetLastErrorMessage(
-    SSchedule   *aSchedule,
-    const char  *format,
-    ...
+__SScheduleReleaseBlockRangeAtIndex(
+    SSchedule       *aSchedule,
+    unsigned int    index
 )
 {
-    if ( aSchedule->lastErrorMessage ) {
-        if ( aSchedule->lastErrorMessage != aSchedule->staticErrorMessageBuffer ) free((void*)aSchedule->lastErrorMessage);
-        aSchedule->lastErrorMessage = NULL;
-    }
-    if ( format ) {
-        va_list     argv;
-        int         strLen;
-        
-        va_start(argv, format);
-        strLen = vsnprintf(NULL, 0, format, argv);
-        va_end(argv);
-        
-        if ( strLen + 1 < sizeof(aSchedule->staticErrorMessageBuffer) ) {
-            aSchedule->lastErrorMessage = aSchedule->staticErrorMessageBuffer;
-            va_start(argv, format);
-            vsnprintf((char*)aSchedule->staticErrorMessageBuffer, sizeof(aSchedule->staticErrorMessageBuffer), format, argv);
-            va_end(argv);
-        } else if ( (aSchedule->lastErrorMessage = (const char*)malloc(strLen + 1)) ) {
-            va_start(argv, format);
-            vsnprintf((char*)aSchedule->lastErrorMessage, strLen + 1, format, argv);
-            va_end(argv);
-        } else {
-            fprintf(stderr, "FATAL:  unable to allocate space to stash last error message\n");
-            exit(ENOMEM);
-        }
+    if ( (index < aSchedule->blockRangesCapacity) && aSchedule->blockRanges[index] ) {
+        STimeRangeRelease(aSchedule->blockRanges[index]);
+        aSchedule->blockRanges[index] = NULL;
+        aSchedule->blockRangesCount--;
     }
 }
 
 //
 
-SScheduleRef
-SScheduleCreate(
-    STimeRangeRef   period
+void
+__SScheduleReleaseBlockRanges(
+    SSchedule       *aSchedule
 )
 {
-    SSchedule       *newSchedule = __SScheduleAlloc();
-
-    if ( newSchedule ) {
-        newSchedule->period = STimeRangeRetain(period);
-    }
-    return (SScheduleRef)newSchedule;
+    unsigned int    i = 0;
+    
+    while ( aSchedule->blockRangesCount && (i < aSchedule->blockRangesCapacity) ) __SScheduleReleaseBlockRangeAtIndex(aSchedule, i++);
 }
 
 //
 
-SScheduleRef
-SScheduleCreateWithFileQuick(
-    const char  *filepath
+void
+__SScheduleMoveBlockRanges(
+    SSchedule       *aSchedule,
+    unsigned int    toIndex,
+    unsigned int    fromIndex,
+    unsigned int    count
 )
 {
-    SSchedule   *newSchedule = NULL;
-    sqlite3     *dbHandle;
-    int         rc;
-    
-    rc = sqlite3_open_v2(filepath, &dbHandle, SQLITE_OPEN_READONLY, NULL);
-    if ( rc == SQLITE_OK ) {
-        sqlite3_stmt    *sqlQuery;
+    //
+    // Mirror a memmove() of count blocks from fromIndex to toIndex in the cache
+    // of materialized ranges, so each cached range follows its block.  The
+    // caller has already released the ranges of any blocks being overwritten,
+    // and slots at or beyond blockCount are always empty:
+    //
+    if ( ! aSchedule->blockRangesCount || (toIndex == fromIndex) || (count == 0) ) return;
+    if ( aSchedule->blockRangesCapacity < aSchedule->blockCapacity ) {
+        STimeRangeRef   *newBlockRanges = realloc(aSchedule->blockRanges, aSchedule->blockCapacity * sizeof(STimeRangeRef));
         
-        rc = sqlite3_prepare_v2(dbHandle, "SELECT period FROM schedule LIMIT 1", -1, &sqlQuery, NULL);
-        if ( rc == SQLITE_OK ) {
-            const unsigned char *colVal;
-            STimeRangeRef       period = NULL;
-            unsigned int        blockCount = 0;
-            SScheduleBlock      *head = NULL, *last = NULL;
-            
-            //
-            // Get the SSchedule instance vars:
-            //
-            rc = sqlite3_step(sqlQuery);
-            if ( rc == SQLITE_ROW ) {
-                colVal = sqlite3_column_text(sqlQuery, 0);
-                if ( colVal && *colVal ) {
-                    period = STimeRangeCreateWithString((const char*)colVal, NULL);
-                    if ( ! period || ! STimeRangeIsValid(period) ) {
-                        if ( period ) STimeRangeRelease(period);
-                        period = NULL;
-                        rc = SQLITE_CORRUPT;
-                    }
-                } else {
-                    // Fake an error code:
-                    rc = SQLITE_CORRUPT;
-                }
-            }
-            sqlite3_finalize(sqlQuery);
-            
-            if ( period ) {
-                //
-                // Get the list of scheduled blocks:
-                //
-                rc = sqlite3_prepare_v2(dbHandle, "SELECT period FROM blocks ORDER BY block_id", -1, &sqlQuery, NULL);
-                if ( rc == SQLITE_OK ) {
-                    while ( (rc = sqlite3_step(sqlQuery)) == SQLITE_ROW ) {
-                        SScheduleBlock  *newBlock = NULL;
-                        
-                        colVal = sqlite3_column_text(sqlQuery, 0);
-                        if ( colVal && *colVal ) {
-                            STimeRangeRef   blockPeriod = STimeRangeCreateWithString((const char*)colVal, NULL);
-                            if ( blockPeriod && STimeRangeIsValid(blockPeriod) ) {
-                                newBlock = SScheduleBlockAlloc();
-                                if ( newBlock ) {
-                                    newBlock->period = blockPeriod;
-                                    if ( ! head ) {
-                                        head = last = newBlock;
-                                    } else {
-                                        last->link = newBlock;
-                                        last = newBlock;
-                                    }
-                                    blockCount++;
-                                    rc = SQLITE_OK;
-                                } else {
-                                    STimeRangeRelease(blockPeriod);
-                                    blockPeriod = NULL;
-                                    rc = SQLITE_NOMEM;
-                                }
-                            }  else {
-                                if ( blockPeriod ) STimeRangeRelease(blockPeriod);
-                                blockPeriod = NULL;
-                                rc = SQLITE_CORRUPT;
-                            }
-                        } else {
-                            rc = SQLITE_CORRUPT;
-                        }
-                        if ( rc !=  SQLITE_OK) break;
-                    }
-                    if ( rc == SQLITE_DONE ) {
-                        //
-                        // We've got everything, create the new object:
-                        //
-                        newSchedule = __SScheduleAlloc();
-                        if ( newSchedule ) {
-                            newSchedule->period = STimeRangeRetain(period);
-                            newSchedule->blockCount = blockCount;
-                            newSchedule->blocks = head;
-                            rc = SQLITE_OK;
-                        } else {
-                            //
-                            // Ugh...get rid of the block list:
-                            //
-                            while ( head ) {
-                                SScheduleBlock  *next = head->link;
-                                
-                                SScheduleBlockDealloc(head);
-                                head = next;
-                            }
-                            rc = SQLITE_NOMEM;
-                        }
-                    }
-                    sqlite3_finalize(sqlQuery);
-                }
-                STimeRangeRelease(period);
-            }
-        }
-        sqlite3_close_v2(dbHandle);
-        if ( ! newSchedule && (rc != SQLITE_OK) ) {
-            fprintf(stderr, "ERROR:  unable to open `%s` (sqlite err = %d)\n", filepath, rc);
+        if ( ! newBlockRanges ) {
+            __SScheduleReleaseBlockRanges(aSchedule);
+            return;
         }
+        memset(&newBlockRanges[aSchedule->blockRangesCapacity], 0, (aSchedule->blockCapacity - aSchedule->blockRangesCapacity) * sizeof(STimeRangeRef));
+        aSchedule->blockRanges = newBlockRanges;
+        aSchedule->blockRangesCapacity = aSchedule->blockCapacity;
+    }
+    memmove(&aSchedule->blockRanges[toIndex], &aSchedule->blockRanges[fromIndex], count * sizeof(STimeRangeRef));
+    if ( toIndex < fromIndex ) {
+        unsigned int    clearFrom = ( toIndex + count > fromIndex ) ? toIndex + count : fromIndex;
+        
+        memset(&aSchedule->blockRanges[clearFrom], 0, (fromIndex + count - clearFrom) * sizeof(STimeRangeRef));
     } else {
-        if ( dbHandle ) {
-            fprintf(stderr, "ERROR:  unable to open `%s` (sqlite err = %d, %s)\n", filepath, rc, sqlite3_errmsg(dbHandle));
-            sqlite3_close_v2(dbHandle);
-        } else {
-            fprintf(stderr, "ERROR:  unable to open `%s` (sqlite err = %d)\n", filepath, rc);
-        }
+        unsigned int    clearTo = ( fromIndex + count < toIndex ) ? fromIndex + count : toIndex;
+        
+        memset(&aSchedule->blockRanges[fromIndex], 0, (clearTo - fromIndex) * sizeof(STimeRangeRef));
     }
-    return newSchedule;
 }
 
 //
 
-SScheduleRef
-SScheduleCreateWithFile(
-    const char  *filepath
+void
+__SScheduleCarryBlockRanges(
+    SSchedule               *aSchedule,
+    const SScheduleBlock    *newBlocks,
+    unsigned int            newBlockCount,
+    unsigned int            newBlockCapacity
 )
 {
-    SScheduleRef    newSchedule = NULL;
-    sqlite3         *dbHandle;
-    int             rc;
+    STimeRangeRef           *newBlockRanges;
+    unsigned int            i = 0, j = 0;
     
-    rc = sqlite3_open_v2(filepath, &dbHandle, SQLITE_OPEN_READONLY, NULL);
-    if ( rc == SQLITE_OK ) {
-        sqlite3_stmt    *sqlQuery;
-        
-        rc = sqlite3_prepare_v2(dbHandle, "SELECT period FROM schedule LIMIT 1", -1, &sqlQuery, NULL);
-        if ( rc == SQLITE_OK ) {
-            const unsigned char *colVal;
-            STimeRangeRef       period = NULL;
-            
-            //
-            // Get the SSchedule instance vars:
-            //
-            rc = sqlite3_step(sqlQuery);
-            if ( rc == SQLITE_ROW ) {
-                colVal = sqlite3_column_text(sqlQuery, 0);
-                if ( colVal && *colVal ) {
-                    period = STimeRangeCreateWithString((const char*)colVal, NULL);
-                    if ( ! period || ! STimeRangeIsValid(period) ) {
-                        if ( period ) STimeRangeRelease(period);
-                        period = NULL;
-                        rc = SQLITE_CORRUPT;
-                    }
-                } else {
-                    // Fake an error code:
-                    rc = SQLITE_CORRUPT;
-                }
-            }
-            sqlite3_finalize(sqlQuery);
-            
-            if ( period ) {
-                newSchedule = SScheduleCreate(period);
-                STimeRangeRelease(period);
-                
-                if ( newSchedule ) {
-                    //
-                    // Get the list of scheduled blocks:
-                    //
-                    rc = sqlite3_prepare_v2(dbHandle, "SELECT period FROM blocks ORDER BY block_id", -1, &sqlQuery, NULL);
-                    if ( rc == SQLITE_OK ) {
-                        while ( (rc = sqlite3_step(sqlQuery)) == SQLITE_ROW ) {
-                            colVal = sqlite3_column_text(sqlQuery, 0);
-                            if ( colVal && *colVal ) {
-                                STimeRangeRef   blockPeriod = STimeRangeCreateWithString((const char*)colVal, NULL);
-                                if ( blockPeriod && STimeRangeIsValid(blockPeriod) ) {
-                                    rc = SScheduleAddScheduledBlock(newSchedule, blockPeriod) ? SQLITE_OK : SQLITE_NOMEM;
-                                    STimeRangeRelease(blockPeriod);
-                                }  else {
-                                    if ( blockPeriod ) STimeRangeRelease(blockPeriod);
-                                    blockPeriod = NULL;
-                                    rc = SQLITE_CORRUPT;
-                                }
-                            } else {
-                                rc = SQLITE_CORRUPT;
-                            }
-                            if ( rc !=  SQLITE_OK) break;
-                        }
-                        if ( rc != SQLITE_DONE ) {
-                            SScheduleRelease(newSchedule);
-                            newSchedule = NULL;
-                        }
-                        sqlite3_finalize(sqlQuery);
-                    }
-                }
+    //
+    // The blocks are being replaced by newBlocks:  carry each cached range
+    // over to the index of its block if that block survived unchanged, release
+    // it otherwise.  Both arrays are ordered by start time, so this is a single
+    // linear pass:
+    //
+    if ( ! aSchedule->blockRangesCount ) return;
+    if ( ! (newBlockRanges = calloc(newBlockCapacity, sizeof(STimeRangeRef))) ) {
+        __SScheduleReleaseBlockRanges(aSchedule);
+        return;
+    }
+    while ( (i < aSchedule->blockRangesCapacity) && (i < aSchedule->blockCount) ) {
+        if ( aSchedule->blockRanges[i] ) {
+            while ( (j < newBlockCount) && (newBlocks[j].start < aSchedule->blocks[i].start) ) j++;
+            if ( (j < newBlockCount) && __SScheduleBlockIsEqual(&newBlocks[j], &aSchedule->blocks[i]) ) {
+                newBlockRanges[j] = aSchedule->blockRanges[i];
+                aSchedule->blockRanges[i] = NULL;
+            } else {
+                __SScheduleReleaseBlockRangeAtIndex(aSchedule, i);
             }
         }
-        sqlite3_close_v2(dbHandle);
-        if ( ! newSchedule && (rc != SQLITE_OK) ) {
-            fprintf(stderr, "ERROR:  unable to open `%s` (sqlite err = %d)\n", filepath, rc);
-        }
-    } else {
-        if ( dbHandle ) {
-            fprintf(stderr, "ERROR:  unable to open `%s` (sqlite err = %d, %s)\n", filepath, rc, sqlite3_errmsg(dbHandle));
-            sqlite3_close_v2(dbHandle);
-        } else {
-            fprintf(stderr, "ERROR:  unable to open `%s` (sqlite err = %d)\n", filepath, rc);
-        }
+        i++;
     }
-    return newSchedule;
+    free((void*)aSchedule->blockRanges);
+    aSchedule->blockRanges = newBlockRanges;
+    aSchedule->blockRangesCapacity = newBlockCapacity;
 }
 
 //
 
-void
-SScheduleRelease(
-    SScheduleRef    aSchedule
+bool
+__SScheduleGetGapAtIndex(
+    SSchedule       *aSchedule,
+    unsigned int    index,
+    SScheduleBlock  *outGap
 )
 {
-    SSchedule       *SCHEDULE = (SSchedule*)aSchedule;
+    //
+    // The index-th gap precedes the index-th block; gap blockCount trails the
+    // last block.  Returns false if the gap is empty:
+    //
+    if ( index == 0 ) {
+        outGap->start = aSchedule->periodBlock.start;
+    } else {
+        SScheduleBlock  *prevBlock = &aSchedule->blocks[index - 1];
+
+        if ( ! SSCHEDULE_BLOCK_HAS_END(prevBlock) ) return false;
+        outGap->start = prevBlock->end + 1;
+    }
+    if ( index == aSchedule->blockCount ) {
+        outGap->end = aSchedule->periodBlock.end;
+    } else {
+        SScheduleBlock  *nextBlock = &aSchedule->blocks[index];
 
-    if ( --(SCHEDULE->refcount) == 0 ) __SScheduleDealloc(SCHEDULE);
+        if ( ! SSCHEDULE_BLOCK_HAS_START(nextBlock) ) return false;
+        outGap->end = nextBlock->start - 1;
+    }
+    return ( outGap->start <= outGap->end );
 }
 
 //
 
-SScheduleRef
-SScheduleRetain(
-    SScheduleRef    aSchedule
+#ifndef SSCHEDULE_GAP_INDEX_MIN_BLOCKS
+#define SSCHEDULE_GAP_INDEX_MIN_BLOCKS 64
+#endif
+
+//
+// The gap index is an implicit binary tree over the blockCount + 1 gaps in
+// the schedule:  leaf i holds the length of gap i (UINT64_MAX if unbounded,
+// zero if empty) and each interior node the largest gap in its subtree.  It is
+// built on demand by SScheduleFindOpenBlockOfDuration(), updated leaf by leaf
+// while the block count stays the same, and discarded (to be rebuilt in O(n)
+// by the next query) whenever the block count changes.
+//
+
+uint64_t
+__SScheduleGapLength(
+    const SScheduleBlock    *aGap
 )
 {
-    SSchedule       *SCHEDULE = (SSchedule*)aSchedule;
-
-    SCHEDULE->refcount++;
-    return aSchedule;
+    if ( SSCHEDULE_BLOCK_HAS_START(aGap) && SSCHEDULE_BLOCK_HAS_END(aGap) ) return (uint64_t)aGap->end - (uint64_t)aGap->start + 1;
+    return UINT64_MAX;
 }
 
 //
 
-STimeRangeRef
-SScheduleGetPeriod(
-    SScheduleRef    aSchedule
+void
+__SScheduleGapIndexUpdate(
+    SSchedule       *aSchedule,
+    unsigned int    gapIndex
 )
 {
-    return aSchedule->period;
+    if ( aSchedule->isGapIndexValid && (gapIndex <= aSchedule->blockCount) ) {
+        unsigned int    node = aSchedule->gapIndexLeafCount + gapIndex;
+        SScheduleBlock  gap;
+
+        aSchedule->gapIndex[node] = __SScheduleGetGapAtIndex(aSchedule, gapIndex, &gap) ? __SScheduleGapLength(&gap) : 0;
+        while ( node > 1 ) {
+            uint64_t    l, r;
+
+            node /= 2;
+            l = aSchedule->gapIndex[2 * node];
+            r = aSchedule->gapIndex[2 * node + 1];
+            aSchedule->gapIndex[node] = ( l > r ) ? l : r;
+        }
+    }
 }
 
 //
 
-unsigned int
-SScheduleGetBlockCount(
-    SScheduleRef    aSchedule
+bool
+__SScheduleGapIndexBuild(
+    SSchedule       *aSchedule
 )
 {
-    return aSchedule->blockCount;
-}
+    unsigned int    leafCount = 1, gapCount = aSchedule->blockCount + 1, i;
+    SScheduleBlock  gap;
 
-//
+    while ( leafCount < gapCount ) leafCount *= 2;
+    if ( leafCount != aSchedule->gapIndexLeafCount ) {
+        uint64_t    *newGapIndex = realloc(aSchedule->gapIndex, 2 * leafCount * sizeof(uint64_t));
 
-STimeRangeRef
-SScheduleGetBlockAtIndex(
-    SScheduleRef    aSchedule,
-    unsigned int    index
+        if ( ! newGapIndex ) return false;
+        aSchedule->gapIndex = newGapIndex;
+        aSchedule->gapIndexLeafCount = leafCount;
+    }
+    for ( i = 0; i < leafCount; i++ ) {
+        aSchedule->gapIndex[leafCount + i] = ( (i < gapCount) && __SScheduleGetGapAtIndex(aSchedule, i, &gap) ) ? __SScheduleGapLength(&gap) : 0;
+    }
+    for ( i = leafCount - 1; i >= 1; i-- ) {
+        uint64_t    l = aSchedule->gapIndex[2 * i], r = aSchedule->gapIndex[2 * i + 1];
+
+        aSchedule->gapIndex[i] = ( l > r ) ? l : r;
+    }
+    aSchedule->isGapIndexValid = true;
+    return true;
+}
+
+//
+
+unsigned int
+__SScheduleGapIndexFindFirst(
+    SSchedule       *aSchedule,
+    unsigned int    node,
+    unsigned int    nodeLo,
+    unsigned int    nodeHi,
+    unsigned int    lo,
+    unsigned int    hi,
+    uint64_t        minLength
 )
 {
-    if ( index < aSchedule->blockCount ) {
-        SScheduleBlock  *block = aSchedule->blocks;
+    //
+    // Leftmost gap index in [lo, hi] of at least minLength seconds within the
+    // subtree at node (which covers gaps [nodeLo, nodeHi]), or UINT_MAX:
+    //
+    if ( (hi < nodeLo) || (lo > nodeHi) || (aSchedule->gapIndex[node] < minLength) ) return UINT_MAX;
+    if ( nodeLo == nodeHi ) return nodeLo;
+    
+    unsigned int    nodeMid = nodeLo + (nodeHi - nodeLo) / 2;
+    unsigned int    found = __SScheduleGapIndexFindFirst(aSchedule, 2 * node, nodeLo, nodeMid, lo, hi, minLength);
+    
+    if ( found == UINT_MAX ) found = __SScheduleGapIndexFindFirst(aSchedule, 2 * node + 1, nodeMid + 1, nodeHi, lo, hi, minLength);
+    return found;
+}
+
+//
+// Block searches all look for a partition point:  the index of the first block
+// for which a predicate no longer holds.  The search starts from the finger
+// (the position of the previous search) and gallops outward before finishing
+// with a binary search, so runs of nearby lookups -- e.g. chronological
+// allocation -- cost amortized O(1) while arbitrary lookups stay O(log n).
+//
+
+typedef bool (*__SScheduleBlockPredicate)(const SScheduleBlock *aBlock, const void *key);
+
+unsigned int
+__SScheduleFindPartitionPoint(
+    SSchedule                   *aSchedule,
+    __SScheduleBlockPredicate   isBefore,
+    const void                  *key
+)
+{
+    unsigned int                lo, hi, step = 1, finger = aSchedule->finger;
+
+    if ( finger > aSchedule->blockCount ) finger = aSchedule->blockCount;
+    if ( (finger < aSchedule->blockCount) && isBefore(&aSchedule->blocks[finger], key) ) {
+        //
+        // Gallop forward:
+        //
+        lo = finger + 1;
+        hi = aSchedule->blockCount;
+        while ( (aSchedule->blockCount - finger > step) && isBefore(&aSchedule->blocks[finger + step], key) ) {
+            lo = finger + step + 1;
+            step *= 2;
+        }
+        if ( aSchedule->blockCount - finger > step ) hi = finger + step;
+    } else {
+        //
+        // Gallop backward:
+        //
+        lo = 0;
+        hi = finger;
+        while ( (finger >= step) && ! isBefore(&aSchedule->blocks[finger - step], key) ) {
+            hi = finger - step;
+            step *= 2;
+        }
+        if ( finger >= step ) lo = finger - step + 1;
+    }
+    while ( lo < hi ) {
+        unsigned int            mid = lo + (hi - lo) / 2;
 
-        while ( index-- ) block = block->link;
-        return block->period;
+        if ( isBefore(&aSchedule->blocks[mid], key) ) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
     }
-    return NULL;
+    aSchedule->finger = lo;
+    return lo;
 }
 
 //
 
-const char*
-SScheduleGetLastErrorMessage(
-    SScheduleRef    aSchedule
+bool
+__SScheduleBlockStartsNotAfterBlock(
+    const SScheduleBlock    *aBlock,
+    const void              *key
 )
 {
-    return aSchedule->lastErrorMessage;
+    return ( __SScheduleBlockCmpStart(aBlock, (const SScheduleBlock*)key) <= 0 );
+}
+
+unsigned int
+__SScheduleFindBlockIndexAfter(
+    SSchedule               *aSchedule,
+    const SScheduleBlock    *aBlock
+)
+{
+    //
+    // Index of the first block whose start time follows that of aBlock (or
+    // blockCount if there is no such block):
+    //
+    return __SScheduleFindPartitionPoint(aSchedule, __SScheduleBlockStartsNotAfterBlock, aBlock);
 }
 
 //
 
 bool
-SScheduleIsFull(
-    SScheduleRef    aSchedule
+__SScheduleBlockStartsNotAfterTime(
+    const SScheduleBlock    *aBlock,
+    const void              *key
 )
 {
-    // A full schedule means that all dates in the scheduling period are
-    // marked, implying the list of blocks is one element long and its
-    // period is equal to the scheduling period:
-    return ((aSchedule->blockCount == 1) && STimeRangeIsEqual(aSchedule->period, aSchedule->blocks->period));
+    return ( aBlock->start <= *((const time_t*)key) );
+}
+
+unsigned int
+__SScheduleFindBlockIndexStartingAfterTime(
+    SSchedule       *aSchedule,
+    time_t          theTime
+)
+{
+    //
+    // Index of the first block that starts after theTime (or blockCount if
+    // there is no such block):
+    //
+    return __SScheduleFindPartitionPoint(aSchedule, __SScheduleBlockStartsNotAfterTime, &theTime);
 }
 
 //
 
-STimeRangeRef
-SScheduleGetNextOpenBlock(
-    SScheduleRef    aSchedule
+bool
+__SScheduleBlockEndsBeforeTime(
+    const SScheduleBlock    *aBlock,
+    const void              *key
 )
 {
-    STimeRangeRef   outBlock = NULL;
+    return ( aBlock->end < *((const time_t*)key) );
+}
 
+unsigned int
+__SScheduleCountBlocksEndingBeforeTime(
+    SSchedule       *aSchedule,
+    time_t          theTime
+)
+{
     //
-    // Trivial case, nothing scheduled:
+    // Number of leading blocks that end prior to theTime:
     //
-    if ( aSchedule->blockCount == 0 ) return STimeRangeRetain(aSchedule->period);
+    return __SScheduleFindPartitionPoint(aSchedule, __SScheduleBlockEndsBeforeTime, &theTime);
+}
+
+//
 
+void
+__SScheduleDidMutate(
+    SSchedule       *aSchedule
+)
+{
     //
-    // First, check if there's unaccounted time at the start of the scheduling
-    // period:
+    // The block count changed, so the gap index must be rebuilt:
+    //
+    aSchedule->isGapIndexValid = false;
+}
+
+//
+
+void
+__SScheduleFinalizeStatements(
+    SSchedule       *aSchedule
+)
+{
+    unsigned int    i = 0;
+    
+    while ( i < kSScheduleStatementMax ) {
+        if ( aSchedule->dbStatements[i] ) {
+            sqlite3_finalize(aSchedule->dbStatements[i]);
+            aSchedule->dbStatements[i] = NULL;
+        }
+        i++;
+    }
+}
+
+//
+
+void
+__SScheduleCloseFile(
+    SSchedule       *aSchedule
+)
+{
+    //
+    // The stored blocks describe the file, so they go with the connection:
     //
-    outBlock = STimeRangeLeading(aSchedule->period, aSchedule->blocks->period);
-    if ( ! outBlock ) {
+    __SScheduleFinalizeStatements(aSchedule);
+    if ( aSchedule->dbHandle ) {
         //
-        // For each pair of blocks, check if they are contiguous; if not, then
-        // there's open time between them:
+        // Leave the file in rollback-journal mode, as we found it, so a later
+        // read-only load doesn't need a write-ahead log beside it:
         //
-        SScheduleBlock      *block = aSchedule->blocks;
-
-        while ( ! outBlock && block->link ) {
-            if ( ! STimeRangeIsContiguous(block->period, block->link->period) ) {
-                //
-                // Run from end+1 of one through start of the other:
-                //
-                time_t      start, end;
-                STimeRangeGetEndTime(block->period, &start);
-                STimeRangeGetStartTime(block->link->period, &end);
-                start++; end--;
-                outBlock = STimeRangeCreate(start, end);
-                break;
-            }
-            block = block->link;
+        if ( ! sqlite3_db_readonly(aSchedule->dbHandle, "main") ) sqlite3_exec(aSchedule->dbHandle, "PRAGMA journal_mode = DELETE", NULL, NULL, NULL);
+        sqlite3_close_v2(aSchedule->dbHandle);
+        aSchedule->dbHandle = NULL;
+    }
+    if ( aSchedule->dbFilepath ) {
+        free((void*)aSchedule->dbFilepath);
+        aSchedule->dbFilepath = NULL;
+    }
+    if ( aSchedule->storedBlocks ) {
+        free((void*)aSchedule->storedBlocks);
+        aSchedule->storedBlocks = NULL;
+    }
+    aSchedule->storedBlockCount = 0;
+    aSchedule->hasStoredBlocks = false;
+}
+
+//
+
+void
+__SScheduleDealloc(
+    SSchedule   *aSchedule
+)
+{
+    __SScheduleReleaseBlockRanges(aSchedule);
+    if ( aSchedule->blockRanges ) free((void*)aSchedule->blockRanges);
+    if ( aSchedule->gapIndex ) free((void*)aSchedule->gapIndex);
+    if ( aSchedule->blocks ) free((void*)aSchedule->blocks);
+    __SScheduleCloseFile(aSchedule);
+    if ( aSchedule->period ) STimeRangeRelease(aSchedule->period);
+    if ( aSchedule->lastErrorMessage && (aSchedule->lastErrorMessage != aSchedule->staticErrorMessageBuffer) ) free((void*)aSchedule->lastErrorMessage);
+    free((void*)aSchedule);
+}
+
+//
+
+void
+__SScheduleDebug(
+    SSchedule   *aSchedule
+)
+{
+    if ( aSchedule ) {
+        unsigned int    i = 0;
+
+        printf(
+                "SSchedule@%p(%u) {\n"
+                "  period: %s\n"
+                "  blockCount: %u\n",
+                aSchedule, SREFCOUNT_GET(aSchedule->refcount),
+                STimeRangeGetCString(aSchedule->period),
+                aSchedule->blockCount
+            );
+        while ( i < aSchedule->blockCount ) {
+            char            blockPeriodStr[STIMERANGE_CSTRING_MAX];
+
+            printf("    %d : %s\n", i, __SScheduleBlockFormat(&aSchedule->blocks[i], blockPeriodStr, sizeof(blockPeriodStr)));
+            i++;
         }
-        if ( ! outBlock && block ) {
-            //
-            // We're at the last block of time, check for trailing time:
-            //
-            outBlock = STimeRangeTrailing(aSchedule->period, block->period);
+        printf(
+                "  lastErrorMessage: %s\n"
+                "}\n",
+                ( aSchedule->lastErrorMessage ? aSchedule->lastErrorMessage : "<none>" )
+            );
+    }
+}
+
+//
+
+#include <stdarg.h>
+
+void
+__SScheduleSetLastErrorMessage(
+    SSchedule   *aSchedule,
+    const char  *format,
+    ...
+)
+{
+    if ( aSchedule->lastErrorMessage ) {
+        if ( aSchedule->lastErrorMessage != aSchedule->staticErrorMessageBuffer ) free((void*)aSchedule->lastErrorMessage);
+        aSchedule->lastErrorMessage = NULL;
+    }
+    if ( format ) {
+        va_list     argv;
+        int         strLen;
+        
+        va_start(argv, format);
+        strLen = vsnprintf(NULL, 0, format, argv);
+        va_end(argv);
+        
+        if ( strLen + 1 < sizeof(aSchedule->staticErrorMessageBuffer) ) {
+            aSchedule->lastErrorMessage = aSchedule->staticErrorMessageBuffer;
+            va_start(argv, format);
+            vsnprintf((char*)aSchedule->staticErrorMessageBuffer, sizeof(aSchedule->staticErrorMessageBuffer), format, argv);
+            va_end(argv);
+        } else if ( (aSchedule->lastErrorMessage = (const char*)malloc(strLen + 1)) ) {
+            va_start(argv, format);
+            vsnprintf((char*)aSchedule->lastErrorMessage, strLen + 1, format, argv);
+            va_end(argv);
+        } else {
+            fprintf(stderr, "FATAL:  unable to allocate space to stash last error message\n");
+            exit(ENOMEM);
         }
     }
-    return outBlock;
 }
 
 //
 
-STimeRangeRef
-SScheduleGetNextOpenBlockBeforeTime(
-    SScheduleRef    aSchedule,
-    time_t          beforeTime
+int
+__SScheduleBlockQSortCmp(
+    const void  *lhs,
+    const void  *rhs
+)
+{
+    return __SScheduleBlockCmpStart((const SScheduleBlock*)lhs, (const SScheduleBlock*)rhs);
+}
+
+//
+
+bool
+__SScheduleAddBlocks(
+    SSchedule       *aSchedule,
+    SScheduleBlock  *newBlocks,
+    unsigned int    newBlockCount
 )
 {
-    STimeRangeRef   outBlock = NULL;
+    SScheduleBlock  *mergedBlocks, *mergedBlock;
+    unsigned int    mergedCapacity = SSCHEDULE_BLOCKS_MIN_CAPACITY, i = 0, j = 0;
     
     //
-    // Full?
+    // newBlocks have already been clipped to the scheduling period; sort them
+    // and then merge with the existing blocks in a single pass:
     //
-    if ( SScheduleIsFull(aSchedule) ) return NULL;
+    if ( newBlockCount == 0 ) return true;
+    qsort(newBlocks, newBlockCount, sizeof(SScheduleBlock), __SScheduleBlockQSortCmp);
     
-    //
-    // Is beforeTime inside the scheduling period?
-    //
-    if ( ! STimeRangeContainsTime(aSchedule->period, beforeTime) ) {
-        //
-        // Does beforeTime occur AFTER the scheduling period?
-        //
-        time_t      endOfPeriod;
+    while ( mergedCapacity < aSchedule->blockCount + newBlockCount ) mergedCapacity *= 2;
+    mergedBlocks = malloc(mergedCapacity * sizeof(SScheduleBlock));
+    if ( ! mergedBlocks ) return false;
+    
+    mergedBlock = mergedBlocks - 1;
+    while ( (i < aSchedule->blockCount) || (j < newBlockCount) ) {
+        SScheduleBlock  *nextBlock;
         
-        if ( ! STimeRangeGetEndTime(aSchedule->period, &endOfPeriod) ) return NULL;
-        if ( beforeTime < endOfPeriod ) return NULL;
-        beforeTime = endOfPeriod + 1;
+        if ( (j == newBlockCount) || ((i < aSchedule->blockCount) && (__SScheduleBlockCmpStart(&aSchedule->blocks[i], &newBlocks[j]) <= 0)) ) {
+            nextBlock = &aSchedule->blocks[i++];
+        } else {
+            nextBlock = &newBlocks[j++];
+        }
+        if ( (mergedBlock >= mergedBlocks) && __SScheduleBlockDoesTouch(mergedBlock, nextBlock) ) {
+            __SScheduleBlockAbsorb(mergedBlock, nextBlock);
+        } else {
+            *(++mergedBlock) = *nextBlock;
+        }
     }
+    __SScheduleCarryBlockRanges(aSchedule, mergedBlocks, (mergedBlock - mergedBlocks) + 1, mergedCapacity);
+    if ( aSchedule->blocks ) free((void*)aSchedule->blocks);
+    aSchedule->blocks = mergedBlocks;
+    aSchedule->blockCapacity = mergedCapacity;
+    aSchedule->blockCount = (mergedBlock - mergedBlocks) + 1;
+    __SScheduleDidMutate(aSchedule);
+    return true;
+}
 
+//
+
+int
+__SScheduleStoredBlockQSortCmp(
+    const void              *lhs,
+    const void              *rhs
+)
+{
+    const SScheduleBlock    *lhsBlock = &((const SScheduleStoredBlock*)lhs)->block;
+    const SScheduleBlock    *rhsBlock = &((const SScheduleStoredBlock*)rhs)->block;
+    int                     cmp = __SScheduleBlockCmpStart(lhsBlock, rhsBlock);
+    
     //
-    // Trivial case, nothing scheduled:
+    // Rows read from a file that wasn't sanity checked may share a start time:
+    //
+    if ( cmp == 0 ) cmp = ( lhsBlock->end < rhsBlock->end ) ? -1 : ( lhsBlock->end > rhsBlock->end );
+    return cmp;
+}
+
+//
+// Schedule files record their schema version in the SQLite header's user_version
+// field.  Version 1 files predate that (user_version is zero) and hold each range
+// as a date-time string; version 2 files hold each bound as an integer, with NULL
+// meaning unbounded, so nothing needs parsing or formatting on the way through.
+// Version 1 files are still read, and are upgraded when written to.
+//
+
+#define SSCHEDULE_FILE_VERSION_NONE 0
+#define SSCHEDULE_FILE_VERSION_1    1
+#define SSCHEDULE_FILE_VERSION      2
+
+//
+// Connections are tuned for short-lived processes making a few small transactions:
+// with write-ahead logging and synchronous=NORMAL a commit appends to the log
+// without waiting on fsync(), and pages are read through a memory map.  Other
+// processes working on the same file are waited on for a while rather than
+// failing outright.
+//
+
+#ifndef SSCHEDULE_JOURNAL_MODE
+#define SSCHEDULE_JOURNAL_MODE      "WAL"
+#endif
+
+#ifndef SSCHEDULE_MMAP_SIZE
+#define SSCHEDULE_MMAP_SIZE         268435456
+#endif
+
+#ifndef SSCHEDULE_BUSY_TIMEOUT
+#define SSCHEDULE_BUSY_TIMEOUT      5000
+#endif
+
+//
+
+bool
+__SScheduleIsFileImmutable(
+    const char      *filepath
+)
+{
+    struct stat     finfo;
+    char            walFilepath[PATH_MAX];
+    
+    //
+    // A file no one has permission to write (that has no write-ahead log left
+    // behind in it) won't change, so it can be read without any locking:
+    //
+    if ( (stat(filepath, &finfo) != 0) || ! S_ISREG(finfo.st_mode) || (finfo.st_mode & (S_IWUSR | S_IWGRP | S_IWOTH)) ) return false;
+    if ( snprintf(walFilepath, sizeof(walFilepath), "%s-wal", filepath) >= (int)sizeof(walFilepath) ) return false;
+    return ( stat(walFilepath, &finfo) != 0 );
+}
+
+//
+
+char*
+__SScheduleCreateImmutableURI(
+    const char      *filepath
+)
+{
+    char            *uri = malloc(3 * strlen(filepath) + sizeof("file://?immutable=1"));
+    
+    //
+    // A "file:" URI for filepath with the immutable parameter set; characters that
+    // have meaning in a URI are percent-encoded:
     //
-    if ( aSchedule->blockCount == 0 ) {
-        if ( STimeRangeContainsTime(aSchedule->period, beforeTime) ) {
-            if ( STimeRangeIsStartTimeSet(aSchedule->period) ) {
-                time_t  startTime;
+    if ( uri ) {
+        char        *p = stpcpy(uri, ( *filepath == '/' ) ? "file://" : "file:");
         
-                STimeRangeGetStartTime(aSchedule->period, &startTime);
-                return STimeRangeCreate(startTime, beforeTime - 1);
+        while ( *filepath ) {
+            if ( (*filepath == '%') || (*filepath == '?') || (*filepath == '#') ) {
+                p += sprintf(p, "%%%02X", (unsigned char)*filepath);
+            } else {
+                *p++ = *filepath;
             }
-            return STimeRangeCreateWithEnd(beforeTime - 1);
-        } else if ( STimeRangeDoesTimeFollowRange(aSchedule->period, beforeTime) ) {
-            //
-            // The whole period, please:
+            filepath++;
+        }
+        strcpy(p, "?immutable=1");
+    }
+    return uri;
+}
+
+//
+
+bool
+__SScheduleIsOpenFile(
+    SSchedule       *aSchedule,
+    const char      *filepath
+)
+{
+    struct stat     finfo;
+    
+    //
+    // The open connection is only good for filepath if the path still names the
+    // file it has open; if the file was since replaced or unlinked, writing
+    // through the connection would go to the orphaned file and be lost:
+    //
+    return ( aSchedule->dbHandle && (strcmp(aSchedule->dbFilepath, filepath) == 0) &&
+             (stat(filepath, &finfo) == 0) &&
+             (finfo.st_dev == aSchedule->dbFileInfo.st_dev) &&
+             (finfo.st_ino == aSchedule->dbFileInfo.st_ino) );
+}
+
+//
+
+int
+__SScheduleGetStatement(
+    SSchedule       *aSchedule,
+    unsigned int    statementId,
+    sqlite3_stmt*   *outStatement
+)
+{
+    //
+    // Statements are prepared the first time they're needed and kept (reset after
+    // each use) for as long as the connection is open:
+    //
+    if ( ! aSchedule->dbStatements[statementId] ) {
+        int         rc = sqlite3_prepare_v3(aSchedule->dbHandle, __SScheduleStatementSQL[statementId], -1, SQLITE_PREPARE_PERSISTENT, &aSchedule->dbStatements[statementId], NULL);
+        
+        if ( rc != SQLITE_OK ) return rc;
+    }
+    *outStatement = aSchedule->dbStatements[statementId];
+    return SQLITE_OK;
+}
+
+//
+
+int
+__SScheduleQueryInteger(
+    SSchedule       *aSchedule,
+    unsigned int    statementId,
+    int64_t         *outValue
+)
+{
+    sqlite3_stmt    *sqlQuery;
+    int             rc = __SScheduleGetStatement(aSchedule, statementId, &sqlQuery);
+    
+    if ( rc != SQLITE_OK ) return rc;
+    rc = sqlite3_step(sqlQuery);
+    if ( rc == SQLITE_ROW ) {
+        *outValue = sqlite3_column_int64(sqlQuery, 0);
+        rc = SQLITE_OK;
+    }
+    sqlite3_reset(sqlQuery);
+    return rc;
+}
+
+//
+
+int
+__SScheduleGetFileVersion(
+    SSchedule       *aSchedule,
+    int             *outVersion
+)
+{
+    int64_t         userVersion, tableCount;
+    int             rc = __SScheduleQueryInteger(aSchedule, kSScheduleStatementGetUserVersion, &userVersion);
+    
+    if ( rc != SQLITE_OK ) return rc;
+    if ( userVersion == 0 ) {
+        //
+        // Either a version 1 file or an empty database:
+        //
+        rc = __SScheduleQueryInteger(aSchedule, kSScheduleStatementCountTables, &tableCount);
+        if ( rc != SQLITE_OK ) return rc;
+        userVersion = ( tableCount > 0 ) ? SSCHEDULE_FILE_VERSION_1 : SSCHEDULE_FILE_VERSION_NONE;
+    } else if ( (userVersion < 0) || (userVersion > SSCHEDULE_FILE_VERSION) ) {
+        return SQLITE_FORMAT;
+    }
+    *outVersion = (int)userVersion;
+    return SQLITE_OK;
+}
+
+//
+
+int
+__SScheduleBindBlock(
+    sqlite3_stmt            *sqlQuery,
+    int                     paramIndex,
+    const SScheduleBlock    *aBlock
+)
+{
+    int                     rc;
+    
+    //
+    // Bind the start of aBlock as parameter paramIndex and its end as the next:
+    //
+    rc = SSCHEDULE_BLOCK_HAS_START(aBlock) ? sqlite3_bind_int64(sqlQuery, paramIndex, aBlock->start) : sqlite3_bind_null(sqlQuery, paramIndex);
+    if ( rc == SQLITE_OK ) rc = SSCHEDULE_BLOCK_HAS_END(aBlock) ? sqlite3_bind_int64(sqlQuery, paramIndex + 1, aBlock->end) : sqlite3_bind_null(sqlQuery, paramIndex + 1);
+    return rc;
+}
+
+//
+
+bool
+__SScheduleColumnBlock(
+    sqlite3_stmt            *sqlQuery,
+    int                     columnIndex,
+    int                     fileVersion,
+    SScheduleBlock          *outBlock
+)
+{
+    //
+    // Version 1 files hold the range in the one column as a string (the infinite
+    // range was written as "-"); otherwise the start and end are in this column
+    // and the next:
+    //
+    if ( fileVersion == SSCHEDULE_FILE_VERSION_1 ) {
+        const char          *colVal = (const char*)sqlite3_column_text(sqlQuery, columnIndex);
+        STimeRangeValue     aValue;
+        
+        if ( colVal && (strcmp(colVal, "-") == 0) ) {
+            outBlock->start = SSCHEDULE_BLOCK_NO_START;
+            outBlock->end = SSCHEDULE_BLOCK_NO_END;
+            return true;
+        }
+        return ( colVal && *colVal &&
+                 STimeRangeValueParseWithLength(colVal, sqlite3_column_bytes(sqlQuery, columnIndex), &aValue, NULL) &&
+                 __SScheduleBlockInitWithValue(outBlock, &aValue) );
+    }
+    
+    switch ( sqlite3_column_type(sqlQuery, columnIndex) ) {
+        case SQLITE_NULL:
+            outBlock->start = SSCHEDULE_BLOCK_NO_START;
+            break;
+        case SQLITE_INTEGER:
+            outBlock->start = sqlite3_column_int64(sqlQuery, columnIndex);
+            break;
+        default:
+            return false;
+    }
+    switch ( sqlite3_column_type(sqlQuery, columnIndex + 1) ) {
+        case SQLITE_NULL:
+            outBlock->end = SSCHEDULE_BLOCK_NO_END;
+            break;
+        case SQLITE_INTEGER:
+            outBlock->end = sqlite3_column_int64(sqlQuery, columnIndex + 1);
+            break;
+        default:
+            return false;
+    }
+    return ( outBlock->start <= outBlock->end );
+}
+
+//
+
+int
+__SScheduleReadPeriod(
+    SSchedule               *aSchedule,
+    int                     fileVersion,
+    STimeRangeRef           *outPeriod
+)
+{
+    sqlite3_stmt            *sqlQuery;
+    SScheduleBlock          periodBlock;
+    int                     rc;
+    
+    rc = __SScheduleGetStatement(aSchedule, ( fileVersion == SSCHEDULE_FILE_VERSION_1 ) ? kSScheduleStatementSelectPeriodV1 : kSScheduleStatementSelectPeriod, &sqlQuery);
+    if ( rc != SQLITE_OK ) return rc;
+    rc = sqlite3_step(sqlQuery);
+    if ( rc == SQLITE_ROW ) {
+        if ( ! __SScheduleColumnBlock(sqlQuery, 0, fileVersion, &periodBlock) ) {
+            rc = SQLITE_CORRUPT;
+        } else if ( ! (*outPeriod = __SScheduleBlockCreateTimeRange(&periodBlock)) ) {
+            rc = SQLITE_NOMEM;
+        } else {
+            rc = SQLITE_OK;
+        }
+    } else if ( rc == SQLITE_DONE ) {
+        // Fake an error code:
+        rc = SQLITE_CORRUPT;
+    }
+    sqlite3_reset(sqlQuery);
+    return rc;
+}
+
+//
+
+void
+__SScheduleSetStoredBlocks(
+    SSchedule               *aSchedule,
+    SScheduleStoredBlock    *storedBlocks,
+    unsigned int            storedBlockCount,
+    int64_t                 dataVersion
+)
+{
+    //
+    // Takes ownership of storedBlocks (which must be sorted), the rows of the file
+    // as of dataVersion on the schedule's connection:
+    //
+    if ( aSchedule->storedBlocks ) free((void*)aSchedule->storedBlocks);
+    aSchedule->storedBlocks = storedBlocks;
+    aSchedule->storedBlockCount = storedBlockCount;
+    aSchedule->storedDataVersion = dataVersion;
+    aSchedule->hasStoredBlocks = true;
+}
+
+//
+
+bool
+__SScheduleAreStoredBlocksCurrent(
+    SSchedule               *aSchedule,
+    int64_t                 dataVersion
+)
+{
+    //
+    // The data_version of a connection only changes when another connection
+    // commits to the file, so if it hasn't, the stored blocks still match it:
+    //
+    return ( aSchedule->hasStoredBlocks && (dataVersion == aSchedule->storedDataVersion) );
+}
+
+//
+
+void
+__SScheduleConfigureConnection(
+    sqlite3         *dbHandle
+)
+{
+    char            mmapPragma[64];
+    
+    //
+    // The tuning is best-effort; the journal mode is only switched on a
+    // connection that will write, so loading a file never modifies it:
+    //
+    sqlite3_busy_timeout(dbHandle, SSCHEDULE_BUSY_TIMEOUT);
+    if ( ! sqlite3_db_readonly(dbHandle, "main") ) sqlite3_exec(dbHandle, "PRAGMA journal_mode = " SSCHEDULE_JOURNAL_MODE "; PRAGMA synchronous = NORMAL", NULL, NULL, NULL);
+    sqlite3_snprintf(sizeof(mmapPragma), mmapPragma, "PRAGMA mmap_size = %lld", (long long)SSCHEDULE_MMAP_SIZE);
+    sqlite3_exec(dbHandle, mmapPragma, NULL, NULL, NULL);
+}
+
+//
+
+int
+__SScheduleQueryDataVersion(
+    sqlite3         *dbHandle,
+    int64_t         *outDataVersion
+)
+{
+    sqlite3_stmt    *sqlQuery;
+    int             rc = sqlite3_prepare_v2(dbHandle, __SScheduleStatementSQL[kSScheduleStatementGetDataVersion], -1, &sqlQuery, NULL);
+    
+    if ( rc != SQLITE_OK ) return rc;
+    rc = sqlite3_step(sqlQuery);
+    if ( rc == SQLITE_ROW ) {
+        *outDataVersion = sqlite3_column_int64(sqlQuery, 0);
+        rc = SQLITE_OK;
+    }
+    sqlite3_finalize(sqlQuery);
+    return rc;
+}
+
+//
+
+int
+__SScheduleUpgradeFile(
+    SSchedule       *aSchedule
+)
+{
+    sqlite3         *dbHandle = NULL;
+    struct stat     finfo;
+    int64_t         dataVersion, newDataVersion;
+    int             rc;
+    
+    //
+    // The file was loaded read-only and is now being saved, so it gets a
+    // read-write connection in place of the old one:
+    //
+    rc = sqlite3_open_v2(aSchedule->dbFilepath, &dbHandle, SQLITE_OPEN_READWRITE, NULL);
+    if ( rc != SQLITE_OK ) {
+        if ( dbHandle ) sqlite3_close_v2(dbHandle);
+        return rc;
+    }
+    sqlite3_busy_timeout(dbHandle, SSCHEDULE_BUSY_TIMEOUT);
+    
+    //
+    // The stored blocks stay usable if no one has written the file since it was
+    // loaded.  The new connection's data_version is read before the old one's is
+    // checked, so a write in between is caught by the save's own check.  An
+    // immutable connection never sees writes, so it can't vouch for the file:
+    //
+    if ( aSchedule->hasStoredBlocks ) {
+        if ( aSchedule->isDbImmutable ||
+             (stat(aSchedule->dbFilepath, &finfo) != 0) ||
+             (finfo.st_dev != aSchedule->dbFileInfo.st_dev) ||
+             (finfo.st_ino != aSchedule->dbFileInfo.st_ino) ||
+             (__SScheduleQueryDataVersion(dbHandle, &newDataVersion) != SQLITE_OK) ||
+             (__SScheduleQueryInteger(aSchedule, kSScheduleStatementGetDataVersion, &dataVersion) != SQLITE_OK) ||
+             ! __SScheduleAreStoredBlocksCurrent(aSchedule, dataVersion) ) {
+            aSchedule->hasStoredBlocks = false;
+        } else {
+            aSchedule->storedDataVersion = newDataVersion;
+        }
+    }
+    __SScheduleFinalizeStatements(aSchedule);
+    sqlite3_close_v2(aSchedule->dbHandle);
+    aSchedule->dbHandle = dbHandle;
+    aSchedule->isDbImmutable = false;
+    if ( stat(aSchedule->dbFilepath, &aSchedule->dbFileInfo) != 0 ) memset(&aSchedule->dbFileInfo, 0, sizeof(aSchedule->dbFileInfo));
+    __SScheduleConfigureConnection(dbHandle);
+    return SQLITE_OK;
+}
+
+//
+
+int
+__SScheduleOpenFile(
+    SSchedule       *aSchedule,
+    const char      *filepath,
+    bool            isForWriting
+)
+{
+    sqlite3         *dbHandle = NULL;
+    bool            isImmutable = false;
+    int             rc;
+    
+    //
+    // Keep using the open connection if it's to filepath, upgrading it if it's
+    // read-only and we need to write:
+    //
+    if ( __SScheduleIsOpenFile(aSchedule, filepath) ) {
+        if ( ! isForWriting || ! sqlite3_db_readonly(aSchedule->dbHandle, "main") ) return SQLITE_OK;
+        return __SScheduleUpgradeFile(aSchedule);
+    }
+    __SScheduleCloseFile(aSchedule);
+    
+    //
+    // Files are loaded read-only (immutable, if no one can write to them) and
+    // only opened read-write to be saved:
+    //
+    if ( isForWriting ) {
+        rc = sqlite3_open_v2(filepath, &dbHandle, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, NULL);
+    } else if ( (isImmutable = __SScheduleIsFileImmutable(filepath)) ) {
+        char        *uri = __SScheduleCreateImmutableURI(filepath);
+        
+        if ( ! uri ) return SQLITE_NOMEM;
+        rc = sqlite3_open_v2(uri, &dbHandle, SQLITE_OPEN_READONLY | SQLITE_OPEN_URI, NULL);
+        free((void*)uri);
+    } else {
+        rc = sqlite3_open_v2(filepath, &dbHandle, SQLITE_OPEN_READONLY, NULL);
+    }
+    if ( rc != SQLITE_OK ) {
+        if ( dbHandle ) sqlite3_close_v2(dbHandle);
+        return rc;
+    }
+    if ( ! (aSchedule->dbFilepath = strdup(filepath)) ) {
+        sqlite3_close_v2(dbHandle);
+        return SQLITE_NOMEM;
+    }
+    aSchedule->dbHandle = dbHandle;
+    aSchedule->isDbImmutable = isImmutable;
+    if ( stat(filepath, &aSchedule->dbFileInfo) != 0 ) memset(&aSchedule->dbFileInfo, 0, sizeof(aSchedule->dbFileInfo));
+    __SScheduleConfigureConnection(dbHandle);
+    return SQLITE_OK;
+}
+
+//
+
+int
+__SScheduleReadStoredBlocks(
+    SSchedule               *aSchedule,
+    int                     fileVersion,
+    SScheduleStoredBlock*   *outStoredBlocks,
+    unsigned int            *outStoredBlockCount,
+    bool                    *outIsSorted
+)
+{
+    SScheduleStoredBlock    *storedBlocks = NULL;
+    unsigned int            storedBlockCount = 0, storedBlockCapacity = 0;
+    bool                    isSorted = true;
+    sqlite3_stmt            *sqlQuery;
+    int                     rc;
+    
+    //
+    // Read every row of the blocks table (a block and its row id), noting whether
+    // they arrive in order:
+    //
+    rc = __SScheduleGetStatement(aSchedule, ( fileVersion == SSCHEDULE_FILE_VERSION_1 ) ? kSScheduleStatementSelectBlocksV1 : kSScheduleStatementSelectBlocks, &sqlQuery);
+    if ( rc != SQLITE_OK ) return rc;
+    while ( (rc = sqlite3_step(sqlQuery)) == SQLITE_ROW ) {
+        if ( storedBlockCount == storedBlockCapacity ) {
+            SScheduleStoredBlock    *biggerStoredBlocks;
+            
+            storedBlockCapacity = storedBlockCapacity ? 2 * storedBlockCapacity : SSCHEDULE_BLOCKS_MIN_CAPACITY;
+            biggerStoredBlocks = realloc(storedBlocks, storedBlockCapacity * sizeof(SScheduleStoredBlock));
+            if ( biggerStoredBlocks ) {
+                storedBlocks = biggerStoredBlocks;
+            } else {
+                storedBlockCapacity = storedBlockCount;
+            }
+        }
+        if ( storedBlockCount == storedBlockCapacity ) {
+            rc = SQLITE_NOMEM;
+            break;
+        }
+        if ( ! __SScheduleColumnBlock(sqlQuery, 1, fileVersion, &storedBlocks[storedBlockCount].block) ) {
+            rc = SQLITE_CORRUPT;
+            break;
+        }
+        storedBlocks[storedBlockCount].rowId = sqlite3_column_int64(sqlQuery, 0);
+        if ( (storedBlockCount > 0) && (__SScheduleStoredBlockQSortCmp(&storedBlocks[storedBlockCount - 1], &storedBlocks[storedBlockCount]) > 0) ) isSorted = false;
+        storedBlockCount++;
+    }
+    sqlite3_reset(sqlQuery);
+    if ( rc != SQLITE_DONE ) {
+        if ( storedBlocks ) free((void*)storedBlocks);
+        return rc;
+    }
+    *outStoredBlocks = storedBlocks;
+    *outStoredBlockCount = storedBlockCount;
+    *outIsSorted = isSorted;
+    return SQLITE_OK;
+}
+
+//
+
+int
+__SScheduleReadFile(
+    SSchedule               *aSchedule,
+    bool                    shouldValidate
+)
+{
+    SScheduleStoredBlock    *storedBlocks = NULL;
+    unsigned int            storedBlockCount = 0, i = 0;
+    bool                    isSorted = true;
+    STimeRangeRef           period = NULL;
+    int64_t                 dataVersion;
+    int                     rc, fileVersion;
+    
+    //
+    // Read it all in one transaction, so it's all from the same version of the
+    // file:
+    //
+    rc = sqlite3_exec(aSchedule->dbHandle, "BEGIN", NULL, NULL, NULL);
+    if ( rc != SQLITE_OK ) return rc;
+    rc = __SScheduleQueryInteger(aSchedule, kSScheduleStatementGetDataVersion, &dataVersion);
+    if ( rc == SQLITE_OK ) rc = __SScheduleGetFileVersion(aSchedule, &fileVersion);
+    if ( rc == SQLITE_OK ) {
+        if ( fileVersion == SSCHEDULE_FILE_VERSION_NONE ) {
+            // Fake an error code:
+            rc = SQLITE_CORRUPT;
+        } else {
+            rc = __SScheduleReadPeriod(aSchedule, fileVersion, &period);
+        }
+    }
+    if ( rc == SQLITE_OK ) rc = __SScheduleReadStoredBlocks(aSchedule, fileVersion, &storedBlocks, &storedBlockCount, &isSorted);
+    sqlite3_exec(aSchedule->dbHandle, ( rc == SQLITE_OK ) ? "COMMIT" : "ROLLBACK", NULL, NULL, NULL);
+    
+    if ( rc == SQLITE_OK ) {
+        //
+        // Rows are only rewritten when they change, so they may need sorting:
+        //
+        if ( ! isSorted ) qsort(storedBlocks, storedBlockCount, sizeof(SScheduleStoredBlock), __SScheduleStoredBlockQSortCmp);
+        if ( ! __SScheduleSetPeriod(aSchedule, period) ) {
+            rc = SQLITE_CORRUPT;
+        } else if ( shouldValidate ) {
+            SScheduleBlock  *newBlocks = NULL;
+            
+            //
+            // Each block must intersect the scheduling period; add them all in a
+            // single sorted merge:
+            //
+            if ( (storedBlockCount > 0) && ! (newBlocks = malloc(storedBlockCount * sizeof(SScheduleBlock))) ) rc = SQLITE_NOMEM;
+            while ( (rc == SQLITE_OK) && (i < storedBlockCount) ) {
+                newBlocks[i] = storedBlocks[i].block;
+                if ( ! __SScheduleBlockClipToBlock(&newBlocks[i++], &aSchedule->periodBlock) ) rc = SQLITE_CORRUPT;
+            }
+            if ( (rc == SQLITE_OK) && ! __SScheduleAddBlocks(aSchedule, newBlocks, storedBlockCount) ) rc = SQLITE_NOMEM;
+            if ( newBlocks ) free((void*)newBlocks);
+        } else if ( __SScheduleGrowBlocks(aSchedule, storedBlockCount) ) {
+            //
+            // Use the blocks as-is:
+            //
+            while ( i < storedBlockCount ) {
+                aSchedule->blocks[i] = storedBlocks[i].block;
+                i++;
+            }
+            aSchedule->blockCount = storedBlockCount;
+        } else {
+            rc = SQLITE_NOMEM;
+        }
+    }
+    if ( period ) STimeRangeRelease(period);
+    if ( rc == SQLITE_OK ) {
+        __SScheduleSetStoredBlocks(aSchedule, storedBlocks, storedBlockCount, dataVersion);
+    } else if ( storedBlocks ) {
+        free((void*)storedBlocks);
+    }
+    return rc;
+}
+
+//
+
+SScheduleRef
+SScheduleCreate(
+    STimeRangeRef   period
+)
+{
+    SSchedule       *newSchedule = __SScheduleAlloc();
+
+    if ( newSchedule && ! __SScheduleSetPeriod(newSchedule, period) ) {
+        __SScheduleDealloc(newSchedule);
+        newSchedule = NULL;
+    }
+    return (SScheduleRef)newSchedule;
+}
+
+//
+
+SScheduleRef
+__SScheduleCreateWithFile(
+    const char  *filepath,
+    bool        shouldValidate
+)
+{
+    SSchedule   *newSchedule = __SScheduleAlloc();
+    int         rc = SQLITE_NOMEM;
+    
+    if ( newSchedule ) {
+        //
+        // The schedule keeps the connection:
+        //
+        rc = __SScheduleOpenFile(newSchedule, filepath, false);
+        if ( rc == SQLITE_OK ) rc = __SScheduleReadFile(newSchedule, shouldValidate);
+        if ( rc != SQLITE_OK ) {
+            __SScheduleDealloc(newSchedule);
+            newSchedule = NULL;
+        }
+    }
+    if ( ! newSchedule ) {
+        fprintf(stderr, "ERROR:  unable to open `%s` (sqlite err = %d, %s)\n", filepath, rc, sqlite3_errstr(rc));
+    }
+    return (SScheduleRef)newSchedule;
+}
+
+//
+
+SScheduleRef
+SScheduleCreateWithFileQuick(
+    const char  *filepath
+)
+{
+    return __SScheduleCreateWithFile(filepath, false);
+}
+
+//
+
+SScheduleRef
+SScheduleCreateWithFile(
+    const char  *filepath
+)
+{
+    return __SScheduleCreateWithFile(filepath, true);
+}
+
+//
+
+void
+SScheduleRelease(
+    SScheduleRef    aSchedule
+)
+{
+    SSchedule       *SCHEDULE = (SSchedule*)aSchedule;
+
+    if ( SREFCOUNT_RELEASE(SCHEDULE->refcount) ) __SScheduleDealloc(SCHEDULE);
+}
+
+//
+
+SScheduleRef
+SScheduleRetain(
+    SScheduleRef    aSchedule
+)
+{
+    SSchedule       *SCHEDULE = (SSchedule*)aSchedule;
+
+    SREFCOUNT_RETAIN(SCHEDULE->refcount);
+    return aSchedule;
+}
+
+//
+
+STimeRangeRef
+SScheduleGetPeriod(
+    SScheduleRef    aSchedule
+)
+{
+    return aSchedule->period;
+}
+
+//
+
+unsigned int
+SScheduleGetBlockCount(
+    SScheduleRef    aSchedule
+)
+{
+    return aSchedule->blockCount;
+}
+
+//
+
+STimeRangeRef
+SScheduleGetBlockAtIndex(
+    SScheduleRef    aSchedule,
+    unsigned int    index
+)
+{
+    SSchedule       *SCHEDULE = (SSchedule*)aSchedule;
+    
+    if ( index < aSchedule->blockCount ) {
+        //
+        // Blocks are materialized as STimeRange objects on demand and cached
+        // for as long as the block exists unchanged:
+        //
+        if ( aSchedule->blockRangesCapacity < aSchedule->blockCapacity ) {
+            STimeRangeRef   *newBlockRanges = realloc(SCHEDULE->blockRanges, aSchedule->blockCapacity * sizeof(STimeRangeRef));
+            
+            if ( ! newBlockRanges ) return NULL;
+            memset(&newBlockRanges[aSchedule->blockRangesCapacity], 0, (aSchedule->blockCapacity - aSchedule->blockRangesCapacity) * sizeof(STimeRangeRef));
+            SCHEDULE->blockRanges = newBlockRanges;
+            SCHEDULE->blockRangesCapacity = aSchedule->blockCapacity;
+        }
+        if ( ! aSchedule->blockRanges[index] ) {
+            if ( ! (SCHEDULE->blockRanges[index] = __SScheduleBlockCreateTimeRange(&aSchedule->blocks[index])) ) return NULL;
+            SCHEDULE->blockRangesCount++;
+        }
+        return aSchedule->blockRanges[index];
+    }
+    return NULL;
+}
+
+//
+
+bool
+SScheduleContainsTime(
+    SScheduleRef    aSchedule,
+    time_t          theTime
+)
+{
+    return ( SScheduleGetBlockContainingTime(aSchedule, theTime, NULL) != NULL );
+}
+
+//
+
+STimeRangeRef
+SScheduleGetBlockContainingTime(
+    SScheduleRef    aSchedule,
+    time_t          theTime,
+    unsigned int    *outIndex
+)
+{
+    //
+    // The first block that doesn't end before theTime is the only candidate:
+    //
+    unsigned int    index = __SScheduleCountBlocksEndingBeforeTime((SSchedule*)aSchedule, theTime);
+    
+    if ( (index < aSchedule->blockCount) && __SScheduleBlockStartsNotAfterTime(&aSchedule->blocks[index], &theTime) ) {
+        if ( outIndex ) *outIndex = index;
+        return SScheduleGetBlockAtIndex(aSchedule, index);
+    }
+    return NULL;
+}
+
+//
+
+STimeRangeRef
+SScheduleGetBlockBefore(
+    SScheduleRef    aSchedule,
+    time_t          theTime,
+    unsigned int    *outIndex
+)
+{
+    unsigned int    index = __SScheduleCountBlocksEndingBeforeTime((SSchedule*)aSchedule, theTime);
+    
+    if ( index > 0 ) {
+        if ( outIndex ) *outIndex = index - 1;
+        return SScheduleGetBlockAtIndex(aSchedule, index - 1);
+    }
+    return NULL;
+}
+
+//
+
+STimeRangeRef
+SScheduleGetBlockAfter(
+    SScheduleRef    aSchedule,
+    time_t          theTime,
+    unsigned int    *outIndex
+)
+{
+    unsigned int    index = __SScheduleFindBlockIndexStartingAfterTime((SSchedule*)aSchedule, theTime);
+    
+    if ( index < aSchedule->blockCount ) {
+        if ( outIndex ) *outIndex = index;
+        return SScheduleGetBlockAtIndex(aSchedule, index);
+    }
+    return NULL;
+}
+
+//
+
+const char*
+SScheduleGetLastErrorMessage(
+    SScheduleRef    aSchedule
+)
+{
+    return aSchedule->lastErrorMessage;
+}
+
+//
+
+bool
+SScheduleIsFull(
+    SScheduleRef    aSchedule
+)
+{
+    // A full schedule means that all dates in the scheduling period are
+    // marked, implying the list of blocks is one element long and its
+    // period is equal to the scheduling period:
+    return ((aSchedule->blockCount == 1) && __SScheduleBlockIsEqual(&aSchedule->periodBlock, &aSchedule->blocks[0]));
+}
+
+//
+
+STimeRangeRef
+SScheduleGetNextOpenBlock(
+    SScheduleRef    aSchedule
+)
+{
+    unsigned int    gapIndex = 0;
+    SScheduleBlock  gap;
+
+    //
+    // Trivial case, nothing scheduled:
+    //
+    if ( aSchedule->blockCount == 0 ) return STimeRangeRetain(aSchedule->period);
+
+    //
+    // Leading time in the scheduling period, then the time between each pair of
+    // blocks, then trailing time in the scheduling period:
+    //
+    while ( gapIndex <= aSchedule->blockCount ) {
+        if ( __SScheduleGetGapAtIndex((SSchedule*)aSchedule, gapIndex++, &gap) ) return __SScheduleBlockCreateTimeRange(&gap);
+    }
+    return NULL;
+}
+
+//
+
+bool
+__SScheduleAdjustBeforeTime(
+    SSchedule       *aSchedule,
+    time_t          *beforeTime
+)
+{
+    //
+    // Is beforeTime inside the scheduling period?
+    //
+    if ( ! STimeRangeContainsTime(aSchedule->period, *beforeTime) ) {
+        //
+        // Does beforeTime occur AFTER the scheduling period?
+        //
+        if ( ! SSCHEDULE_BLOCK_HAS_END(&aSchedule->periodBlock) ) return false;
+        if ( *beforeTime < aSchedule->periodBlock.end ) return false;
+        *beforeTime = aSchedule->periodBlock.end + 1;
+    }
+    return true;
+}
+
+//
+
+STimeRangeRef
+SScheduleGetNextOpenBlockBeforeTime(
+    SScheduleRef    aSchedule,
+    time_t          beforeTime
+)
+{
+    unsigned int    gapIndex = 0;
+    SScheduleBlock  gap;
+    
+    //
+    // Full?
+    //
+    if ( SScheduleIsFull(aSchedule) ) return NULL;
+    if ( ! __SScheduleAdjustBeforeTime((SSchedule*)aSchedule, &beforeTime) ) return NULL;
+
+    //
+    // Find the first open block of time and trim it to end prior to beforeTime:
+    //
+    while ( gapIndex <= aSchedule->blockCount ) {
+        if ( __SScheduleGetGapAtIndex((SSchedule*)aSchedule, gapIndex++, &gap) ) {
+            if ( gap.start >= beforeTime ) break;
+            if ( gap.end >= beforeTime ) gap.end = beforeTime - 1;
+            return __SScheduleBlockCreateTimeRange(&gap);
+        }
+    }
+    return NULL;
+}
+
+//
+
+unsigned int
+__SScheduleFindFirstGapOfLength(
+    SSchedule       *aSchedule,
+    unsigned int    gapLo,
+    unsigned int    gapHi,
+    uint64_t        minLength
+)
+{
+    SScheduleBlock  gap;
+    
+    //
+    // Small schedules aren't worth indexing, just scan them:
+    //
+    if ( (aSchedule->blockCount >= SSCHEDULE_GAP_INDEX_MIN_BLOCKS) && (aSchedule->isGapIndexValid || __SScheduleGapIndexBuild(aSchedule)) ) {
+        return __SScheduleGapIndexFindFirst(aSchedule, 1, 0, aSchedule->gapIndexLeafCount - 1, gapLo, gapHi, minLength);
+    }
+    while ( gapLo <= gapHi ) {
+        if ( __SScheduleGetGapAtIndex(aSchedule, gapLo, &gap) && (__SScheduleGapLength(&gap) >= minLength) ) return gapLo;
+        gapLo++;
+    }
+    return UINT_MAX;
+}
+
+//
+
+unsigned int
+SScheduleAllocateNext(
+    SScheduleRef                aSchedule,
+    time_t                      duration,
+    time_t                      beforeTime,
+    unsigned int                count,
+    SScheduleAllocateCallback   callback,
+    void                        *context
+)
+{
+    SSchedule                   *SCHEDULE = (SSchedule*)aSchedule;
+    SScheduleBlock              gap, leadingBlock;
+    unsigned int                gapIndex = 0, allocCount = 0, blockIndex, mergedIndex;
+    bool                        keepGoing = true, hasLeadingBlock = false;
+    
+    if ( (duration <= 0) || (count == 0) || SScheduleIsFull(aSchedule) ) return 0;
+    if ( ! __SScheduleAdjustBeforeTime(SCHEDULE, &beforeTime) ) return 0;
+    
+    //
+    // Reserve room for a new leading block so nothing can fail once we've
+    // started handing out blocks of time:
+    //
+    if ( ! __SScheduleGrowBlocks(SCHEDULE, aSchedule->blockCount + 1) ) return 0;
+    
+    //
+    // Walk the gaps in order, carving each into blocks of duration seconds.
+    // Allocated time always abuts the preceding block (or the following block
+    // for a gap with no lower bound), so we just stretch that block in place:
+    //
+    while ( keepGoing && (allocCount < count) && (gapIndex <= aSchedule->blockCount) ) {
+        if ( ! __SScheduleGetGapAtIndex(SCHEDULE, gapIndex, &gap) ) {
+            gapIndex++;
+            continue;
+        }
+        if ( gap.start >= beforeTime ) break;
+        if ( gap.end >= beforeTime ) gap.end = beforeTime - 1;
+        
+        if ( SSCHEDULE_BLOCK_HAS_START(&gap) ) {
+            time_t              start = gap.start, end;
+            
+            do {
+                end = ( gap.end - start < duration ) ? gap.end : start + duration - 1;
+                keepGoing = callback(aSchedule, start, end, context);
+                allocCount++;
+                start = end + 1;
+            } while ( keepGoing && (allocCount < count) && (end < gap.end) );
+            if ( gapIndex > 0 ) {
+                SCHEDULE->blocks[gapIndex - 1].end = end;
+                __SScheduleReleaseBlockRangeAtIndex(SCHEDULE, gapIndex - 1);
+            } else if ( (aSchedule->blockCount > 0) && (end + 1 == aSchedule->blocks[0].start) ) {
+                SCHEDULE->blocks[0].start = gap.start;
+                __SScheduleReleaseBlockRangeAtIndex(SCHEDULE, 0);
+            } else {
+                leadingBlock.start = gap.start;
+                leadingBlock.end = end;
+                hasLeadingBlock = true;
+            }
+        } else {
+            //
+            // No lower bound, so blocks are carved from the end of the gap:
+            //
+            time_t              end = gap.end, start;
+            
+            do {
+                start = end - duration + 1;
+                keepGoing = callback(aSchedule, start, end, context);
+                allocCount++;
+                end = start - 1;
+            } while ( keepGoing && (allocCount < count) );
+            if ( (aSchedule->blockCount > 0) && (gap.end + 1 == aSchedule->blocks[0].start) ) {
+                SCHEDULE->blocks[0].start = start;
+                __SScheduleReleaseBlockRangeAtIndex(SCHEDULE, 0);
+            } else {
+                leadingBlock.start = start;
+                leadingBlock.end = gap.end;
+                hasLeadingBlock = true;
+            }
+        }
+        gapIndex++;
+    }
+    if ( allocCount == 0 ) return 0;
+    
+    //
+    // Slot-in the new leading block, if any, then coalesce the blocks whose
+    // gaps we filled:
+    //
+    if ( hasLeadingBlock ) {
+        memmove(&SCHEDULE->blocks[1], &aSchedule->blocks[0], aSchedule->blockCount * sizeof(SScheduleBlock));
+        __SScheduleMoveBlockRanges(SCHEDULE, 1, 0, aSchedule->blockCount);
+        SCHEDULE->blocks[0] = leadingBlock;
+        SCHEDULE->blockCount++;
+        gapIndex++;
+    }
+    if ( gapIndex > aSchedule->blockCount ) gapIndex = aSchedule->blockCount;
+    mergedIndex = 0;
+    for ( blockIndex = 1; blockIndex < gapIndex; blockIndex++ ) {
+        if ( __SScheduleBlockDoesTouch(&aSchedule->blocks[mergedIndex], &aSchedule->blocks[blockIndex]) ) {
+            __SScheduleBlockAbsorb(&SCHEDULE->blocks[mergedIndex], &aSchedule->blocks[blockIndex]);
+            __SScheduleReleaseBlockRangeAtIndex(SCHEDULE, mergedIndex);
+            __SScheduleReleaseBlockRangeAtIndex(SCHEDULE, blockIndex);
+        } else if ( ++mergedIndex < blockIndex ) {
+            SCHEDULE->blocks[mergedIndex] = aSchedule->blocks[blockIndex];
+            __SScheduleMoveBlockRanges(SCHEDULE, mergedIndex, blockIndex, 1);
+        }
+    }
+    if ( ++mergedIndex < gapIndex ) {
+        memmove(&SCHEDULE->blocks[mergedIndex], &aSchedule->blocks[gapIndex], (aSchedule->blockCount - gapIndex) * sizeof(SScheduleBlock));
+        __SScheduleMoveBlockRanges(SCHEDULE, mergedIndex, gapIndex, aSchedule->blockCount - gapIndex);
+        SCHEDULE->blockCount -= gapIndex - mergedIndex;
+    }
+    __SScheduleDidMutate(SCHEDULE);
+    return allocCount;
+}
+
+//
+
+bool
+__SScheduleClipGapToWindow(
+    SSchedule       *aSchedule,
+    unsigned int    gapIndex,
+    time_t          duration,
+    time_t          afterTime,
+    time_t          beforeTime,
+    time_t          *outStart,
+    time_t          *outEnd
+)
+{
+    SScheduleBlock  gap;
+    time_t          start, end;
+    
+    if ( ! __SScheduleGetGapAtIndex(aSchedule, gapIndex, &gap) ) return false;
+    start = ( gap.start > afterTime ) ? gap.start : afterTime;
+    end = ( gap.end < beforeTime - 1 ) ? gap.end : beforeTime - 1;
+    if ( (start > end) || ((uint64_t)(end - start) + 1 < (uint64_t)duration) ) return false;
+    *outStart = start;
+    *outEnd = end;
+    return true;
+}
+
+bool
+SScheduleFindOpenBlockOfDuration(
+    SScheduleRef    aSchedule,
+    time_t          duration,
+    time_t          afterTime,
+    time_t          beforeTime,
+    time_t          *outStart,
+    time_t          *outEnd
+)
+{
+    SSchedule       *SCHEDULE = (SSchedule*)aSchedule;
+    unsigned int    gapLo, gapHi, gapIndex;
+    time_t          start, end;
+
+    if ( (duration <= 0) || (afterTime >= beforeTime) ) return false;
+    
+    //
+    // Gaps before gapLo end prior to afterTime; gaps after gapHi start at or after
+    // beforeTime:
+    //
+    gapLo = __SScheduleFindBlockIndexStartingAfterTime(SCHEDULE, afterTime);
+    gapHi = __SScheduleCountBlocksEndingBeforeTime(SCHEDULE, beforeTime - 1);
+    if ( gapLo > gapHi ) return false;
+    
+    //
+    // The first and last candidate gaps may be trimmed by the window; every gap
+    // between them lies wholly inside it:
+    //
+    if ( ! __SScheduleClipGapToWindow(SCHEDULE, gapLo, duration, afterTime, beforeTime, &start, &end) ) {
+        if ( gapHi == gapLo ) return false;
+        gapIndex = ( gapHi - gapLo > 1 ) ? __SScheduleFindFirstGapOfLength(SCHEDULE, gapLo + 1, gapHi - 1, (uint64_t)duration) : UINT_MAX;
+        if ( (gapIndex == UINT_MAX) || ! __SScheduleClipGapToWindow(SCHEDULE, gapIndex, duration, afterTime, beforeTime, &start, &end) ) {
+            if ( ! __SScheduleClipGapToWindow(SCHEDULE, gapHi, duration, afterTime, beforeTime, &start, &end) ) return false;
+        }
+    }
+    if ( outStart ) *outStart = start;
+    if ( outEnd ) *outEnd = end;
+    return true;
+}
+
+//
+
+void
+SScheduleGapIteratorInit(
+    SScheduleGapIterator    *iterator,
+    SScheduleRef            aSchedule,
+    STimeRangeRef           window
+)
+{
+    SSchedule               *SCHEDULE = (SSchedule*)aSchedule;
+    
+    iterator->schedule = aSchedule;
+    iterator->gapIndex = 0;
+    iterator->gapIndexEnd = aSchedule->blockCount;
+    iterator->hasWindowStart = iterator->hasWindowEnd = false;
+    iterator->windowStart = iterator->windowEnd = 0;
+    iterator->isStartSet = iterator->isEndSet = false;
+    if ( window ) {
+        if ( ! STimeRangeIsValid(window) ) {
+            iterator->gapIndex = iterator->gapIndexEnd + 1;
+            return;
+        }
+        //
+        // Skip gaps that end before the window starts or that start after the
+        // window ends:
+        //
+        if ( (iterator->hasWindowStart = STimeRangeGetStartTime(window, &iterator->windowStart)) ) {
+            iterator->gapIndex = __SScheduleFindBlockIndexStartingAfterTime(SCHEDULE, iterator->windowStart);
+        }
+        if ( (iterator->hasWindowEnd = STimeRangeGetEndTime(window, &iterator->windowEnd)) ) {
+            iterator->gapIndexEnd = __SScheduleCountBlocksEndingBeforeTime(SCHEDULE, iterator->windowEnd);
+        }
+    }
+}
+
+//
+
+bool
+SScheduleGapIteratorNext(
+    SScheduleGapIterator    *iterator,
+    time_t                  *outStart,
+    time_t                  *outEnd
+)
+{
+    SScheduleBlock          gap;
+    
+    while ( iterator->gapIndex <= iterator->gapIndexEnd ) {
+        if ( __SScheduleGetGapAtIndex((SSchedule*)iterator->schedule, iterator->gapIndex++, &gap) ) {
+            SScheduleBlock  window = {
+                                    .start = iterator->hasWindowStart ? iterator->windowStart : SSCHEDULE_BLOCK_NO_START,
+                                    .end = iterator->hasWindowEnd ? iterator->windowEnd : SSCHEDULE_BLOCK_NO_END
+                                };
+            
+            if ( __SScheduleBlockClipToBlock(&gap, &window) ) {
+                iterator->isStartSet = SSCHEDULE_BLOCK_HAS_START(&gap);
+                iterator->isEndSet = SSCHEDULE_BLOCK_HAS_END(&gap);
+                if ( outStart && iterator->isStartSet ) *outStart = gap.start;
+                if ( outEnd && iterator->isEndSet ) *outEnd = gap.end;
+                return true;
+            }
+        }
+    }
+    iterator->isStartSet = iterator->isEndSet = false;
+    return false;
+}
+
+//
+
+bool
+SScheduleAddScheduledBlock(
+    SScheduleRef    aSchedule,
+    STimeRangeRef   scheduledBlock
+)
+{
+    SSchedule       *SCHEDULE = (SSchedule*)aSchedule;
+    SScheduleBlock  addThisBlock;
+    unsigned int    insertAt, mergeStart, mergeEnd;
+
+    //
+    // Only the portion of the block that intersects the scheduling period can
+    // be scheduled; if there's nothing left, get outta here now.
+    //
+    if ( ! __SScheduleBlockInitWithTimeRange(&addThisBlock, scheduledBlock) ) return false;
+    if ( ! __SScheduleBlockClipToBlock(&addThisBlock, &aSchedule->periodBlock) ) return false;
+
+    //
+    // Search (from the finger) for the first block that starts after addThisBlock:
+    //
+    insertAt = __SScheduleFindBlockIndexAfter(SCHEDULE, &addThisBlock);
+
+    //
+    // Absorb the preceding block if it intersects or is contiguous, then every
+    // following block that does likewise; blocks in [mergeStart, mergeEnd) get
+    // replaced by the merged block:
+    //
+    mergeStart = mergeEnd = insertAt;
+    if ( (insertAt > 0) && __SScheduleBlockDoesTouch(&aSchedule->blocks[insertAt - 1], &addThisBlock) ) {
+        SScheduleBlock  mergedBlock = aSchedule->blocks[--mergeStart];
+        
+        __SScheduleBlockAbsorb(&mergedBlock, &addThisBlock);
+        addThisBlock = mergedBlock;
+    }
+    while ( (mergeEnd < aSchedule->blockCount) && __SScheduleBlockDoesTouch(&addThisBlock, &aSchedule->blocks[mergeEnd]) ) {
+        __SScheduleBlockAbsorb(&addThisBlock, &aSchedule->blocks[mergeEnd++]);
+    }
+    
+    if ( mergeStart == mergeEnd ) {
+        //
+        // Nothing merged, we need to insert a new block:
+        //
+        if ( ! __SScheduleGrowBlocks(SCHEDULE, aSchedule->blockCount + 1) ) return false;
+        if ( insertAt < aSchedule->blockCount ) {
+            memmove(&SCHEDULE->blocks[insertAt + 1], &aSchedule->blocks[insertAt], (aSchedule->blockCount - insertAt) * sizeof(SScheduleBlock));
+            __SScheduleMoveBlockRanges(SCHEDULE, insertAt + 1, insertAt, aSchedule->blockCount - insertAt);
+        }
+        SCHEDULE->blockCount++;
+    } else if ( mergeEnd - mergeStart > 1 ) {
+        unsigned int    i;
+        
+        //
+        // Close up the space left by the blocks we absorbed:
+        //
+        for ( i = mergeStart; i < mergeEnd; i++ ) __SScheduleReleaseBlockRangeAtIndex(SCHEDULE, i);
+        memmove(&SCHEDULE->blocks[mergeStart + 1], &aSchedule->blocks[mergeEnd], (aSchedule->blockCount - mergeEnd) * sizeof(SScheduleBlock));
+        __SScheduleMoveBlockRanges(SCHEDULE, mergeStart + 1, mergeEnd, aSchedule->blockCount - mergeEnd);
+        SCHEDULE->blockCount -= mergeEnd - mergeStart - 1;
+    }
+    if ( mergeEnd - mergeStart == 1 ) {
+        //
+        // Block count didn't change, only the gaps either side of the merged
+        // block need to be updated in the gap index -- and nothing at all if
+        // the block already covered addThisBlock:
+        //
+        if ( ! __SScheduleBlockIsEqual(&aSchedule->blocks[mergeStart], &addThisBlock) ) {
+            SCHEDULE->blocks[mergeStart] = addThisBlock;
+            __SScheduleReleaseBlockRangeAtIndex(SCHEDULE, mergeStart);
+            __SScheduleGapIndexUpdate(SCHEDULE, mergeStart);
+            __SScheduleGapIndexUpdate(SCHEDULE, mergeStart + 1);
+        }
+    } else {
+        SCHEDULE->blocks[mergeStart] = addThisBlock;
+        __SScheduleDidMutate(SCHEDULE);
+    }
+    return true;
+}
+
+//
+
+bool
+SScheduleAddScheduledBlocks(
+    SScheduleRef        aSchedule,
+    const STimeRangeRef *scheduledBlocks,
+    unsigned int        scheduledBlockCount
+)
+{
+    SScheduleBlock      *newBlocks;
+    unsigned int        newBlockCount = 0, i = 0;
+    bool                rc;
+    
+    if ( scheduledBlockCount == 0 ) return true;
+    newBlocks = malloc(scheduledBlockCount * sizeof(SScheduleBlock));
+    if ( ! newBlocks ) return false;
+    
+    //
+    // Keep only the portion of each block that intersects the scheduling
+    // period:
+    //
+    while ( i < scheduledBlockCount ) {
+        if ( __SScheduleBlockInitWithTimeRange(&newBlocks[newBlockCount], scheduledBlocks[i++]) &&
+             __SScheduleBlockClipToBlock(&newBlocks[newBlockCount], &aSchedule->periodBlock) ) newBlockCount++;
+    }
+    rc = __SScheduleAddBlocks((SSchedule*)aSchedule, newBlocks, newBlockCount);
+    free((void*)newBlocks);
+    return rc;
+}
+
+//
+
+bool
+SScheduleAddScheduledBlockValues(
+    SScheduleRef            aSchedule,
+    const STimeRangeValue   *scheduledBlocks,
+    unsigned int            scheduledBlockCount
+)
+{
+    SScheduleBlock          *newBlocks;
+    unsigned int            newBlockCount = 0, i = 0;
+    bool                    rc;
+    
+    if ( scheduledBlockCount == 0 ) return true;
+    newBlocks = malloc(scheduledBlockCount * sizeof(SScheduleBlock));
+    if ( ! newBlocks ) return false;
+    
+    while ( i < scheduledBlockCount ) {
+        if ( __SScheduleBlockInitWithValue(&newBlocks[newBlockCount], &scheduledBlocks[i++]) &&
+             __SScheduleBlockClipToBlock(&newBlocks[newBlockCount], &aSchedule->periodBlock) ) newBlockCount++;
+    }
+    rc = __SScheduleAddBlocks((SSchedule*)aSchedule, newBlocks, newBlockCount);
+    free((void*)newBlocks);
+    return rc;
+}
+
+//
+
+bool
+SScheduleRemoveScheduledBlock(
+    SScheduleRef    aSchedule,
+    STimeRangeRef   unscheduledBlock
+)
+{
+    SSchedule       *SCHEDULE = (SSchedule*)aSchedule;
+    SScheduleBlock  removeThisBlock, remnants[2];
+    unsigned int    removeStart = 0, removeEnd = aSchedule->blockCount, remnantCount = 0;
+
+    //
+    // Only the portion of the block that intersects the scheduling period can
+    // have been scheduled; if there's nothing left, there's nothing to do.
+    //
+    if ( ! __SScheduleBlockInitWithTimeRange(&removeThisBlock, unscheduledBlock) ) return false;
+    if ( ! __SScheduleBlockClipToBlock(&removeThisBlock, &aSchedule->periodBlock) ) return true;
+
+    //
+    // Blocks in [removeStart, removeEnd) intersect removeThisBlock:
+    //
+    if ( SSCHEDULE_BLOCK_HAS_START(&removeThisBlock) ) removeStart = __SScheduleCountBlocksEndingBeforeTime(SCHEDULE, removeThisBlock.start);
+    if ( SSCHEDULE_BLOCK_HAS_END(&removeThisBlock) ) removeEnd = __SScheduleFindBlockIndexStartingAfterTime(SCHEDULE, removeThisBlock.end);
+    if ( removeStart >= removeEnd ) return true;
+
+    //
+    // The first and last of those blocks may extend beyond removeThisBlock, in
+    // which case the excess remains scheduled (a block that contains
+    // removeThisBlock gets split in two):
+    //
+    if ( aSchedule->blocks[removeStart].start < removeThisBlock.start ) {
+        remnants[remnantCount] = aSchedule->blocks[removeStart];
+        remnants[remnantCount++].end = removeThisBlock.start - 1;
+    }
+    if ( aSchedule->blocks[removeEnd - 1].end > removeThisBlock.end ) {
+        remnants[remnantCount] = aSchedule->blocks[removeEnd - 1];
+        remnants[remnantCount++].start = removeThisBlock.end + 1;
+    }
+    
+    //
+    // Replace the blocks in [removeStart, removeEnd) with the remnants:
+    //
+    if ( remnantCount > removeEnd - removeStart ) {
+        if ( ! __SScheduleGrowBlocks(SCHEDULE, aSchedule->blockCount + 1) ) return false;
+    }
+    if ( remnantCount != removeEnd - removeStart ) {
+        unsigned int    i;
+        
+        for ( i = removeStart; i < removeEnd; i++ ) __SScheduleReleaseBlockRangeAtIndex(SCHEDULE, i);
+        memmove(&SCHEDULE->blocks[removeStart + remnantCount], &aSchedule->blocks[removeEnd], (aSchedule->blockCount - removeEnd) * sizeof(SScheduleBlock));
+        __SScheduleMoveBlockRanges(SCHEDULE, removeStart + remnantCount, removeEnd, aSchedule->blockCount - removeEnd);
+        SCHEDULE->blockCount = aSchedule->blockCount + remnantCount - (removeEnd - removeStart);
+        memcpy(&SCHEDULE->blocks[removeStart], remnants, remnantCount * sizeof(SScheduleBlock));
+        __SScheduleDidMutate(SCHEDULE);
+    } else {
+        unsigned int    i;
+        
+        //
+        // Block count didn't change, only the trimmed blocks and the gaps either
+        // side of them need to be updated:
+        //
+        memcpy(&SCHEDULE->blocks[removeStart], remnants, remnantCount * sizeof(SScheduleBlock));
+        for ( i = removeStart; i < removeEnd; i++ ) __SScheduleReleaseBlockRangeAtIndex(SCHEDULE, i);
+        for ( i = removeStart; i <= removeEnd; i++ ) __SScheduleGapIndexUpdate(SCHEDULE, i);
+    }
+    return true;
+}
+
+//
+
+bool
+__SScheduleCreateTables(
+    SSchedule       *aSchedule,
+    sqlite3         *dbHandle
+)
+{
+    int             rc;
+    char*           sqlErrMsg;
+    
+    //
+    // Create the schedule table:
+    //
+    rc = sqlite3_exec(
+                dbHandle,
+                "CREATE TABLE schedule ("
+                "  start            INTEGER,"
+                "  end              INTEGER"
+                ")",
+                NULL,
+                NULL,
+                &sqlErrMsg
+            );
+    if ( rc == SQLITE_OK ) {
+        //
+        // Create the blocks table:
+        //
+        rc = sqlite3_exec(
+                    dbHandle,
+                    "CREATE TABLE blocks ("
+                    "  block_id         INTEGER PRIMARY KEY,"
+                    "  start            INTEGER,"
+                    "  end              INTEGER"
+                    ");"
+                    "CREATE UNIQUE INDEX blocks_start ON blocks (start, end);"
+                    "PRAGMA user_version = 2",
+                    NULL,
+                    NULL,
+                    &sqlErrMsg
+                );
+        if ( rc == SQLITE_OK ) {
+            //
+            // Add the default scheduling period record:
             //
-            return STimeRangeCopy(aSchedule->period);
+            rc = sqlite3_exec(
+                        dbHandle,
+                        "INSERT INTO schedule (start, end) VALUES (NULL, NULL)",
+                        NULL,
+                        NULL,
+                        &sqlErrMsg
+                    );            
+        }
+    }
+    if ( rc != SQLITE_OK ) {
+        if ( sqlErrMsg ) {
+            __SScheduleSetLastErrorMessage(aSchedule, "Failure while creating tables in export file (sqlite err = %d): %s", rc, sqlErrMsg);
+            free((void*)sqlErrMsg);
+        } else {
+            __SScheduleSetLastErrorMessage(aSchedule, "Failure while creating tables in export file (sqlite err = %d)", rc);
+        }
+        return false;
+    }
+    return true;
+}
+
+int
+__SScheduleStepBlockQuery(
+    sqlite3_stmt            *sqlQuery,
+    const SScheduleBlock    *aBlock,
+    int64_t                 rowId
+)
+{
+    int                     rc;
+    
+    //
+    // Bind aBlock (if not NULL) as parameters 1 and 2 and rowId (if non-zero) as
+    // the following parameter, then run the query and reset it for reuse:
+    //
+    if ( aBlock ) {
+        rc = __SScheduleBindBlock(sqlQuery, 1, aBlock);
+        if ( rc != SQLITE_OK ) return rc;
+    }
+    if ( rowId ) {
+        rc = sqlite3_bind_int64(sqlQuery, aBlock ? 3 : 1, rowId);
+        if ( rc != SQLITE_OK ) return rc;
+    }
+    rc = sqlite3_step(sqlQuery);
+    sqlite3_reset(sqlQuery);
+    return rc;
+}
+
+//
+
+int
+__SScheduleWriteAllBlocks(
+    SSchedule               *aSchedule,
+    SScheduleStoredBlock    *newStoredBlocks,
+    const char*             *errorSource
+)
+{
+    sqlite3_stmt            *sqlQuery;
+    unsigned int            i = 0;
+    int                     rc;
+    
+    //
+    // Delete all rows from the blocks table and insert every block afresh:
+    //
+    rc = __SScheduleGetStatement(aSchedule, kSScheduleStatementDeleteAllBlocks, &sqlQuery);
+    if ( rc == SQLITE_OK ) rc = __SScheduleStepBlockQuery(sqlQuery, NULL, 0);
+    if ( rc != SQLITE_DONE ) { *errorSource = "scrub scheduled blocks table"; return rc; }
+    rc = __SScheduleGetStatement(aSchedule, kSScheduleStatementInsertBlock, &sqlQuery);
+    if ( rc != SQLITE_OK ) { *errorSource = "prepare scheduled blocks table insert"; return rc; }
+    rc = SQLITE_DONE;
+    while ( i < aSchedule->blockCount ) {
+        rc = __SScheduleStepBlockQuery(sqlQuery, &aSchedule->blocks[i], 0);
+        if ( rc != SQLITE_DONE ) { *errorSource = "insert into scheduled blocks"; break; }
+        newStoredBlocks[i].block = aSchedule->blocks[i];
+        newStoredBlocks[i].rowId = sqlite3_last_insert_rowid(aSchedule->dbHandle);
+        i++;
+    }
+    return ( rc == SQLITE_DONE ) ? SQLITE_OK : rc;
+}
+
+//
+
+int
+__SScheduleWriteChangedBlocks(
+    SSchedule               *aSchedule,
+    SScheduleStoredBlock    *newStoredBlocks,
+    bool                    *isStale,
+    const char*             *errorSource
+)
+{
+    const SScheduleStoredBlock  *storedBlocks = aSchedule->storedBlocks;
+    sqlite3_stmt                *insertQuery, *updateQuery, *deleteQuery;
+    unsigned int                i = 0, j = 0, k = 0;
+    int                         rc;
+    
+    //
+    // Both the blocks and the stored rows are sorted, so a merge finds the blocks
+    // that are stored unchanged; the rest get a row id of zero (SQLite never assigns
+    // that itself):
+    //
+    while ( j < aSchedule->blockCount ) {
+        newStoredBlocks[j].block = aSchedule->blocks[j];
+        newStoredBlocks[j].rowId = 0;
+        while ( (i < aSchedule->storedBlockCount) && (__SScheduleStoredBlockQSortCmp(&storedBlocks[i], &newStoredBlocks[j]) < 0) ) i++;
+        if ( (i < aSchedule->storedBlockCount) && __SScheduleBlockIsEqual(&storedBlocks[i].block, &aSchedule->blocks[j]) ) newStoredBlocks[j].rowId = storedBlocks[i++].rowId;
+        j++;
+    }
+    
+    rc = __SScheduleGetStatement(aSchedule, kSScheduleStatementInsertBlock, &insertQuery);
+    if ( rc == SQLITE_OK ) rc = __SScheduleGetStatement(aSchedule, kSScheduleStatementUpdateBlock, &updateQuery);
+    if ( rc == SQLITE_OK ) rc = __SScheduleGetStatement(aSchedule, kSScheduleStatementDeleteBlock, &deleteQuery);
+    if ( rc != SQLITE_OK ) { *errorSource = "prepare scheduled blocks table queries"; return rc; }
+    
+    //
+    // Walk the stored rows again:  those no block matched are reused for the
+    // unmatched blocks (in order) or, once those run out, deleted.  No block is
+    // written with a value already stored, so the UNIQUE constraint can only fail
+    // if the file was changed behind our back -- as can a row that's gone missing:
+    //
+    i = j = 0;
+    while ( i < aSchedule->storedBlockCount ) {
+        while ( (j < aSchedule->blockCount) && (__SScheduleStoredBlockQSortCmp(&newStoredBlocks[j], &storedBlocks[i]) < 0) ) j++;
+        if ( (j >= aSchedule->blockCount) || (newStoredBlocks[j].rowId != storedBlocks[i].rowId) || ! __SScheduleBlockIsEqual(&newStoredBlocks[j].block, &storedBlocks[i].block) ) {
+            while ( (k < aSchedule->blockCount) && newStoredBlocks[k].rowId ) k++;
+            if ( k < aSchedule->blockCount ) {
+                rc = __SScheduleStepBlockQuery(updateQuery, &newStoredBlocks[k].block, storedBlocks[i].rowId);
+                if ( rc != SQLITE_DONE ) { *errorSource = "update scheduled block"; break; }
+                newStoredBlocks[k++].rowId = storedBlocks[i].rowId;
+            } else {
+                rc = __SScheduleStepBlockQuery(deleteQuery, NULL, storedBlocks[i].rowId);
+                if ( rc != SQLITE_DONE ) { *errorSource = "delete scheduled block"; break; }
+            }
+            if ( sqlite3_changes(aSchedule->dbHandle) != 1 ) { rc = SQLITE_CONSTRAINT; break; }
+        }
+        i++;
+    }
+    
+    //
+    // Any blocks still without a row are inserted:
+    //
+    while ( (rc == SQLITE_DONE || rc == SQLITE_OK) && (k < aSchedule->blockCount) ) {
+        if ( ! newStoredBlocks[k].rowId ) {
+            rc = __SScheduleStepBlockQuery(insertQuery, &newStoredBlocks[k].block, 0);
+            if ( rc != SQLITE_DONE ) { *errorSource = "insert into scheduled blocks"; break; }
+            newStoredBlocks[k].rowId = sqlite3_last_insert_rowid(aSchedule->dbHandle);
+        }
+        k++;
+    }
+    if ( rc == SQLITE_DONE ) rc = SQLITE_OK;
+    *isStale = ( (rc & 0xff) == SQLITE_CONSTRAINT );
+    return rc;
+}
+
+//
+
+bool
+SScheduleWriteToFile(
+    SScheduleRef            aSchedule,
+    const char              *filepath
+)
+{
+    SSchedule               *SCHEDULE = (SSchedule*)aSchedule;
+    SScheduleStoredBlock    *newStoredBlocks = NULL;
+    sqlite3_stmt            *sqlQuery;
+    const char              *errorSource;
+    bool                    isStale = false, isIncremental;
+    int64_t                 dataVersion;
+    int                     rc, fileVersion;
+    
+    //
+    // Use the schedule's connection if it's to filepath, otherwise it's replaced
+    // with one that is:
+    //
+    rc = __SScheduleOpenFile(SCHEDULE, filepath, true);
+    if ( rc != SQLITE_OK ) {
+        __SScheduleSetLastErrorMessage(SCHEDULE, "Unable to open `%s` (sqlite err = %d, %s)\n", filepath, rc, sqlite3_errstr(rc));
+        return false;
+    }
+    
+    //
+    // The blocks as they will be stored, once this succeeds:
+    //
+    if ( (aSchedule->blockCount > 0) && ! (newStoredBlocks = malloc(aSchedule->blockCount * sizeof(SScheduleStoredBlock))) ) {
+        __SScheduleSetLastErrorMessage(SCHEDULE, "Unable to allocate stored blocks list for `%s`", filepath);
+        return false;
+    }
+    
+    //
+    // Start transaction; the write lock is taken immediately so no one else can
+    // change the file between checking its data_version and writing:
+    //
+    rc = sqlite3_exec(SCHEDULE->dbHandle, "BEGIN IMMEDIATE", NULL, NULL, NULL);
+    if ( rc != SQLITE_OK ) { errorSource = "start transaction"; goto cleanup; }
+    rc = __SScheduleQueryInteger(SCHEDULE, kSScheduleStatementGetDataVersion, &dataVersion);
+    if ( rc != SQLITE_OK ) { errorSource = "check data version"; goto cleanup; }
+    rc = __SScheduleGetFileVersion(SCHEDULE, &fileVersion);
+    if ( rc != SQLITE_OK ) { errorSource = "check file version"; goto cleanup; }
+    
+    //
+    // Create the tables in a new file, or upgrade an older file in place; either
+    // way all the blocks get written afresh:
+    //
+    if ( fileVersion == SSCHEDULE_FILE_VERSION_1 ) {
+        rc = sqlite3_exec(SCHEDULE->dbHandle, "DROP TABLE IF EXISTS schedule; DROP TABLE IF EXISTS blocks", NULL, NULL, NULL);
+        if ( rc != SQLITE_OK ) { errorSource = "drop outdated tables"; goto cleanup; }
+    }
+    if ( (fileVersion != SSCHEDULE_FILE_VERSION) && ! __SScheduleCreateTables(SCHEDULE, SCHEDULE->dbHandle) ) {
+        rc = sqlite3_errcode(SCHEDULE->dbHandle);
+        errorSource = "create tables";
+        goto cleanup;
+    }
+    isIncremental = (fileVersion == SSCHEDULE_FILE_VERSION) && __SScheduleAreStoredBlocksCurrent(SCHEDULE, dataVersion);
+    
+    if ( isIncremental ) {
+        //
+        // The file is as we last loaded or saved it, so the period is already
+        // there and only the blocks that changed need to be written:
+        //
+        rc = __SScheduleWriteChangedBlocks(SCHEDULE, newStoredBlocks, &isStale, &errorSource);
+        if ( isStale ) isIncremental = false;
+        else if ( rc != SQLITE_OK ) goto cleanup;
+    }
+    if ( ! isIncremental ) {
+        //
+        // Update the period:
+        //
+        rc = __SScheduleGetStatement(SCHEDULE, kSScheduleStatementUpdatePeriod, &sqlQuery);
+        if ( rc != SQLITE_OK ) { errorSource = "prepare schedule table update"; goto cleanup; }
+        rc = __SScheduleBindBlock(sqlQuery, 1, &SCHEDULE->periodBlock);
+        if ( rc != SQLITE_OK ) { errorSource = "bind scheduling period to query"; goto cleanup; }
+        rc = sqlite3_step(sqlQuery);
+        sqlite3_reset(sqlQuery);
+        if ( rc != SQLITE_DONE ) { errorSource = "update scheduling period"; goto cleanup; }
+        
+        //
+        // Replace all the blocks:
+        //
+        rc = __SScheduleWriteAllBlocks(SCHEDULE, newStoredBlocks, &errorSource);
+        if ( rc != SQLITE_OK ) goto cleanup;
+    }
+    
+    //
+    // Commit the changes:
+    //
+    rc = sqlite3_exec(SCHEDULE->dbHandle, "COMMIT", NULL, NULL, NULL);
+    if ( rc != SQLITE_OK ) { errorSource = "commit transaction"; goto cleanup; }
+    
+    //
+    // The outdated tables' pages were left free by an upgrade; reclaim them:
+    //
+    if ( fileVersion == SSCHEDULE_FILE_VERSION_1 ) sqlite3_exec(SCHEDULE->dbHandle, "VACUUM", NULL, NULL, NULL);
+    
+    //
+    // Hooray, we did it!  Our own commits leave the connection's data_version as
+    // it was:
+    //
+    __SScheduleSetStoredBlocks(SCHEDULE, newStoredBlocks, aSchedule->blockCount, dataVersion);
+    return true;
+    
+cleanup:
+    __SScheduleSetLastErrorMessage(SCHEDULE, "Error at %s for `%s` (sqlite err = %d, %s)\n", errorSource, filepath, rc, sqlite3_errmsg(SCHEDULE->dbHandle));
+    if ( ! sqlite3_get_autocommit(SCHEDULE->dbHandle) ) sqlite3_exec(SCHEDULE->dbHandle, "ROLLBACK", NULL, NULL, NULL);
+    if ( newStoredBlocks ) free((void*)newStoredBlocks);
+    return false;
+}
+
+//
+
+void
+SScheduleSummarize(
+    SScheduleRef    aSchedule,
+    FILE            *outStream
+)
+{
+    if ( aSchedule ) {
+        unsigned int    i = 0;
+
+        fprintf(outStream,
+                "SSchedule@%p(%u) {\n"
+                "  period: %s\n"
+                "  blockCount: %u\n",
+                aSchedule, SREFCOUNT_GET(aSchedule->refcount),
+                STimeRangeGetCString(aSchedule->period),
+                aSchedule->blockCount
+            );
+        while ( i < aSchedule->blockCount ) {
+            char            blockPeriodStr[STIMERANGE_CSTRING_MAX];
+
+            fprintf(outStream,"    %d : %s\n", i, __SScheduleBlockFormat(&aSchedule->blocks[i], blockPeriodStr, sizeof(blockPeriodStr)));
+            i++;
         }
-        return NULL;
+        fprintf(outStream,
+                "  lastErrorMessage: %s\n"
+                "}\n",
+                ( aSchedule->lastErrorMessage ? aSchedule->lastErrorMessage : "<none>" )
+            );
+    }
+}
+
+//
+
+#ifdef SSCHEDULE_UNIT_TEST
+
+#include <stdio.h>
+#include <errno.h>
+
+#ifndef SSCHEDULE_UNIT_TEST_MODEL_SPAN
+#define SSCHEDULE_UNIT_TEST_MODEL_SPAN 8192
+#endif
+
+#ifndef SSCHEDULE_UNIT_TEST_MODEL_OPS
+#define SSCHEDULE_UNIT_TEST_MODEL_OPS 5000
+#endif
+
+#ifndef SSCHEDULE_UNIT_TEST_MODEL_SAVE_INTERVAL
+#define SSCHEDULE_UNIT_TEST_MODEL_SAVE_INTERVAL 500
+#endif
+
+#define SSCHEDULE_UNIT_TEST_MODEL_FILE "sschedule-model.sqlite3db"
+
+//
+// The model is one cell per second of [0, SPAN) plus a cell standing for all
+// time before it and one for all time after it.  Bounded test ranges lie in
+// [MARGIN, SPAN - MARGIN), so the two outer cells are only ever scheduled or
+// cleared whole, by ranges with no lower or upper bound:
+//
+#define SSCHEDULE_UNIT_TEST_MODEL_MARGIN 64
+#define SSCHEDULE_UNIT_TEST_MODEL_CELLS (SSCHEDULE_UNIT_TEST_MODEL_SPAN + 2)
+
+static bool             __SScheduleUnitTestCells[SSCHEDULE_UNIT_TEST_MODEL_CELLS];
+static STimeRangeValue  __SScheduleUnitTestPeriod;
+
+bool
+__SScheduleUnitTestCellRange(
+    STimeRangeValue     value,
+    unsigned int        *outFirst,
+    unsigned int        *outLast
+)
+{
+    //
+    // The cells covered by value, clipped to the schedule's period:
+    //
+    STimeRangeValue     period = __SScheduleUnitTestPeriod;
+    unsigned int        first = ( value.flags & kSTimeRangeValueHasLowerBound ) ? 1 + (unsigned int)value.start : 0;
+    unsigned int        last = ( value.flags & kSTimeRangeValueHasUpperBound ) ? 1 + (unsigned int)value.end : SSCHEDULE_UNIT_TEST_MODEL_CELLS - 1;
+
+    if ( (period.flags & kSTimeRangeValueHasLowerBound) && (first < 1 + period.start) ) first = 1 + (unsigned int)period.start;
+    if ( (period.flags & kSTimeRangeValueHasUpperBound) && (last > 1 + period.end) ) last = 1 + (unsigned int)period.end;
+    *outFirst = first;
+    *outLast = last;
+    return ( first <= last );
+}
+
+//
+
+void
+__SScheduleUnitTestSetCells(
+    STimeRangeValue     value,
+    bool                isScheduled
+)
+{
+    unsigned int        first, last;
+
+    if ( __SScheduleUnitTestCellRange(value, &first, &last) ) {
+        while ( first <= last ) __SScheduleUnitTestCells[first++] = isScheduled;
     }
+}
+
+//
+
+bool
+__SScheduleUnitTestCellIsOpen(
+    unsigned int        cell
+)
+{
+    unsigned int        first, last;
+
+    __SScheduleUnitTestCellRange(STimeRangeValueInfinite, &first, &last);
+    return ( (cell >= first) && (cell <= last) && ! __SScheduleUnitTestCells[cell] );
+}
+
+//
+
+time_t
+__SScheduleUnitTestRandomTime(void)
+{
+    return SSCHEDULE_UNIT_TEST_MODEL_MARGIN + random() % (SSCHEDULE_UNIT_TEST_MODEL_SPAN - 2 * SSCHEDULE_UNIT_TEST_MODEL_MARGIN);
+}
+
+//
+
+STimeRangeValue
+__SScheduleUnitTestRandomValue(
+    time_t              maxDuration
+)
+{
+    time_t              start = __SScheduleUnitTestRandomTime();
+    time_t              end = start + random() % maxDuration;
+
+    if ( end >= SSCHEDULE_UNIT_TEST_MODEL_SPAN - SSCHEDULE_UNIT_TEST_MODEL_MARGIN ) end = SSCHEDULE_UNIT_TEST_MODEL_SPAN - SSCHEDULE_UNIT_TEST_MODEL_MARGIN - 1;
+    return STimeRangeValueMake(start, end);
+}
+
+//
+
+int64_t
+__SScheduleUnitTestStartKey(
+    STimeRangeValue     value
+)
+{
+    return ( value.flags & kSTimeRangeValueHasLowerBound ) ? (int64_t)value.start : INT64_MIN;
+}
+
+//
+
+unsigned int
+__SScheduleUnitTestCheckModel(
+    SScheduleRef        theSchedule,
+    unsigned int        op
+)
+{
+    unsigned int        blockCount = SScheduleGetBlockCount(theSchedule), blockIndex = 0, cell = 0, failures = 0, probe;
+    bool                isFull = true;
 
     //
-    // First, check if there's unaccounted time at the start of the scheduling
-    // period:
+    // The blocks must be exactly the runs of scheduled cells, in order:
     //
-    outBlock = STimeRangeLeading(aSchedule->period, aSchedule->blocks->period);
-    if ( outBlock ) {
-        if ( STimeRangeContainsTime(outBlock, beforeTime) ) {
-            if ( STimeRangeIsStartTimeSet(outBlock) ) {
-                time_t  startTime;
-            
-                STimeRangeGetStartTime(outBlock, &startTime);
-                return STimeRangeCreate(startTime, beforeTime - 1);
+    while ( cell < SSCHEDULE_UNIT_TEST_MODEL_CELLS ) {
+        unsigned int    first = cell;
+
+        if ( ! __SScheduleUnitTestCells[cell] ) {
+            if ( __SScheduleUnitTestCellIsOpen(cell) ) isFull = false;
+            cell++;
+            continue;
+        }
+        while ( (cell < SSCHEDULE_UNIT_TEST_MODEL_CELLS) && __SScheduleUnitTestCells[cell] ) cell++;
+        if ( blockIndex < blockCount ) {
+            STimeRangeValue value = STimeRangeGetValue(SScheduleGetBlockAtIndex(theSchedule, blockIndex));
+            bool            hasStart = ( first > 0 ), hasEnd = ( cell < SSCHEDULE_UNIT_TEST_MODEL_CELLS );
+
+            if ( (((value.flags & kSTimeRangeValueHasLowerBound) != 0) != hasStart) || (hasStart && (value.start != first - 1)) ||
+                 (((value.flags & kSTimeRangeValueHasUpperBound) != 0) != hasEnd) || (hasEnd && (value.end != cell - 2)) )
+            {
+                if ( failures++ < 10 ) printf("schedule model: op %u: block %u does not match the model\n", op, blockIndex);
             }
-            return STimeRangeCreateWithEnd(beforeTime - 1);
         }
-        STimeRangeRelease(outBlock); outBlock = NULL;
+        blockIndex++;
     }
-    
+    if ( blockIndex != blockCount ) {
+        if ( failures++ < 10 ) printf("schedule model: op %u: %u blocks, model has %u\n", op, blockCount, blockIndex);
+    }
+    if ( SScheduleIsFull(theSchedule) != isFull ) {
+        if ( failures++ < 10 ) printf("schedule model: op %u: SScheduleIsFull() disagrees with the model\n", op);
+    }
+
     //
-    // For each pair of blocks, check if they are contiguous; if not, then
-    // there's open time between them:
+    // Point queries and duration searches over random windows (the latter
+    // through the gap index once the schedule is large enough):
     //
-    SScheduleBlock      *block = aSchedule->blocks;
+    for ( probe = 0; probe < 8; probe++ ) {
+        time_t          t = random() % SSCHEDULE_UNIT_TEST_MODEL_SPAN;
+        time_t          afterTime = random() % SSCHEDULE_UNIT_TEST_MODEL_SPAN;
+        time_t          beforeTime = afterTime + 1 + random() % (SSCHEDULE_UNIT_TEST_MODEL_SPAN - afterTime);
+        time_t          duration = 1 + random() % 24, start, end, modelStart = 0, modelEnd = 0;
+        bool            isFound = false, isModelFound = false;
+
+        if ( SScheduleContainsTime(theSchedule, t) != __SScheduleUnitTestCells[1 + t] ) {
+            if ( failures++ < 10 ) printf("schedule model: op %u: SScheduleContainsTime(%lld) disagrees with the model\n", op, (long long)t);
+        }
 
-    while ( ! outBlock && block->link ) {
-        if ( ! STimeRangeIsContiguous(block->period, block->link->period) ) {
-            //
-            // Run from end+1 of one through start of the other:
-            //
-            time_t      start, end;
-            STimeRangeGetEndTime(block->period, &start);
-            STimeRangeGetStartTime(block->link->period, &end);
-            start++; end--;
-            if ( (start <= beforeTime) && (end >= beforeTime) ) {
-                outBlock = STimeRangeCreate(start, beforeTime);
+        t = afterTime;
+        while ( ! isModelFound && (t < beforeTime) ) {
+            if ( ! __SScheduleUnitTestCellIsOpen(1 + t) ) {
+                t++;
+                continue;
             }
-            break;
+            modelStart = t;
+            while ( (t < beforeTime) && __SScheduleUnitTestCellIsOpen(1 + t) ) t++;
+            modelEnd = t - 1;
+            isModelFound = ( modelEnd - modelStart + 1 >= duration );
         }
-        block = block->link;
-    }
-    if ( ! outBlock && block ) {
-        //
-        // We're at the last block of time, check for trailing time:
-        //
-        outBlock = STimeRangeTrailing(aSchedule->period, block->period);
-        if ( outBlock ) {
-            if ( STimeRangeContainsTime(outBlock, beforeTime) ) {
-                if ( STimeRangeIsStartTimeSet(outBlock) ) {
-                    time_t  startTime;
-            
-                    STimeRangeGetStartTime(outBlock, &startTime);
-                    return STimeRangeCreate(startTime, beforeTime - 1);
-                }
-                return STimeRangeCreateWithEnd(beforeTime - 1);
-            }
-            STimeRangeRelease(outBlock); outBlock = NULL;
+        isFound = SScheduleFindOpenBlockOfDuration(theSchedule, duration, afterTime, beforeTime, &start, &end);
+        if ( (isFound != isModelFound) || (isFound && ((start != modelStart) || (end != modelEnd))) ) {
+            if ( failures++ < 10 ) printf("schedule model: op %u: SScheduleFindOpenBlockOfDuration(%lld, %lld, %lld) disagrees with the model\n",
+                                        op, (long long)duration, (long long)afterTime, (long long)beforeTime);
         }
     }
-    return outBlock;
+    return failures;
 }
 
 //
 
+typedef struct SScheduleUnitTestAllocation {
+    time_t          duration, beforeTime;
+    unsigned int    count, failures;
+    bool            hasFirstStart;
+    time_t          firstStart;
+} SScheduleUnitTestAllocation;
+
 bool
-SScheduleAddScheduledBlock(
+__SScheduleUnitTestAllocateCallback(
     SScheduleRef    aSchedule,
-    STimeRangeRef   scheduledBlock
+    time_t          start,
+    time_t          end,
+    void            *context
 )
 {
-    SSchedule       *SCHEDULE = (SSchedule*)aSchedule;
-    SScheduleBlock  *block, *lastBlock;
-    STimeRangeRef   addThisRange = NULL;
-    bool            rc = false;
+    SScheduleUnitTestAllocation *allocation = (SScheduleUnitTestAllocation*)context;
+    time_t                      t;
+
+    (void)aSchedule;
 
     //
-    // First, let's see if the scheduled block is fully contained in the
-    // scheduling period:
-    //
-    if ( STimeRangeIsContained(scheduledBlock, aSchedule->period) ) {
-        addThisRange = STimeRangeRetain(scheduledBlock);
-    }
-    //
-    // Nope, not fully contained...does it at least intersect the scheduling
-    // period?
-    //
-    else if ( STimeRangeDoesIntersect(scheduledBlock, aSchedule->period) ) {
-        addThisRange = STimeRangeIntersection(scheduledBlock, aSchedule->period);
-    }
-    //
-    // The block of time isn't something we can schedule, get outta here now.
+    // Each block must lie in open time before beforeTime, be no longer than
+    // duration and (in a gap with a lower bound) start at the earliest open
+    // second:
     //
-    else {
+    if ( (start < 0) || (end < start) || (end >= allocation->beforeTime) || (end - start + 1 > allocation->duration) ||
+         ((allocation->count == 0) && allocation->hasFirstStart && (start != allocation->firstStart)) )
+    {
+        allocation->failures++;
         return false;
     }
-
-    //
-    // Trivial case, we don't have any blocks yet:
-    //
-    if ( aSchedule->blockCount == 0 ) {
-        block = SScheduleBlockAlloc();
-        if ( block ) {
-            block->period = STimeRangeRetain(addThisRange);
-            SCHEDULE->blocks = block;
-            SCHEDULE->blockCount++;
-            rc = true;
-        }
-        STimeRangeRelease(addThisRange);
-        return rc;
+    for ( t = start; t <= end; t++ ) {
+        if ( ! __SScheduleUnitTestCellIsOpen(1 + t) ) allocation->failures++;
+        __SScheduleUnitTestCells[1 + t] = true;
     }
+    allocation->count++;
+    return true;
+}
 
-    //
-    // Now, we want to figure out where in our range list we should insert
-    // addThisRange:
-    //
-    block = aSchedule->blocks;
-    lastBlock = NULL;
-    while ( block ) {
-        if ( STimeRangeCmp(addThisRange, block->period) > 0 ) break;
-        lastBlock = block;
-        block = block->link;
-    }
+//
 
+void
+__SScheduleUnitTestClearMargin(
+    SScheduleRef    theSchedule
+)
+{
     //
-    // Wherever we ended up, do we intersect or are we contiguous with the
-    // previous scheduled block?
+    // A gap with no lower bound is divided from its end, so allocations there
+    // creep downward; keep them inside the model by clearing the low margin
+    // once the earliest scheduled second falls inside it:
     //
-    rc = false;
-    if ( lastBlock ) {
-        if ( STimeRangeIsContiguous(addThisRange, lastBlock->period) ) {
-            STimeRangeRef   mergedRange = STimeRangeJoin(addThisRange, lastBlock->period);
+    unsigned int    cell = 1;
 
-            STimeRangeRelease(addThisRange);
-            addThisRange = mergedRange;
-            rc = true;
-        }
-        else if ( STimeRangeDoesIntersect(addThisRange, lastBlock->period) ) {
-            if ( ! STimeRangeIsContained(addThisRange, lastBlock->period) ) {
-                STimeRangeRef   mergedRange = STimeRangeUnion(addThisRange, lastBlock->period);
+    if ( ! __SScheduleUnitTestCellIsOpen(0) ) return;
+    while ( (cell < SSCHEDULE_UNIT_TEST_MODEL_CELLS) && ! __SScheduleUnitTestCells[cell] ) cell++;
+    if ( cell - 1 < SSCHEDULE_UNIT_TEST_MODEL_MARGIN ) {
+        STimeRangeValue margin = STimeRangeValueMakeWithEnd(SSCHEDULE_UNIT_TEST_MODEL_MARGIN - 1);
+        STimeRangeRef   marginRange = STimeRangeCreateWithValue(&margin);
 
-                STimeRangeRelease(addThisRange);
-                addThisRange = mergedRange;
-                rc = true;
-            } else {
-                // addThisRange doesn't need to be added:
-                STimeRangeRelease(addThisRange);
-                return true;
-            }
-        }
-        if ( rc ) {
-            if ( ! addThisRange ) return false;
-            STimeRangeRelease(lastBlock->period);
-            lastBlock->period = addThisRange;
-        }
+        SScheduleRemoveScheduledBlock(theSchedule, marginRange);
+        STimeRangeRelease(marginRange);
+        __SScheduleUnitTestSetCells(margin, false);
     }
-    //
-    // If we didn't merge with the previous scheduled block, then how about
-    // merging with a trailing scheduled block?
-    //
-    if ( ! rc && block ) {
-        if ( STimeRangeIsContiguous(addThisRange, block->period) ) {
-            STimeRangeRef   mergedRange = STimeRangeJoin(addThisRange, block->period);
+}
 
-            STimeRangeRelease(addThisRange);
-            addThisRange = mergedRange;
-            rc = true;
-        }
-        else if ( STimeRangeDoesIntersect(addThisRange, block->period) ) {
-            if ( ! STimeRangeIsContained(addThisRange, block->period) ) {
-                STimeRangeRef   mergedRange = STimeRangeUnion(addThisRange, block->period);
+//
+
+unsigned int
+__SScheduleUnitTestAllocate(
+    SScheduleRef    theSchedule,
+    unsigned int    op
+)
+{
+    SScheduleUnitTestAllocation allocation = {
+                                        .duration = 1 + random() % 10,
+                                        .beforeTime = __SScheduleUnitTestRandomTime()
+                                    };
+    unsigned int                count = 1 + random() % 3, allocated, cell;
 
-                STimeRangeRelease(addThisRange);
-                addThisRange = mergedRange;
-                rc = true;
-            } else {
-                // addThisRange doesn't need to be added:
-                STimeRangeRelease(addThisRange);
-                return true;
-            }
-        }
-        if ( rc ) {
-            if ( ! addThisRange ) return false;
-            STimeRangeRelease(block->period);
-            block->period = addThisRange;
-        }
-    }
     //
-    // If we didn't merge, then we need to insert a new SScheduleBlock
-    // between lastBlock and block:
+    // If the first gap has a lower bound, the first block starts at the earliest
+    // open second:
     //
-    if ( ! rc ) {
-        SScheduleBlock  *newBlock = SScheduleBlockAlloc();
-
-        if ( ! newBlock ) return false;
-        newBlock->period = addThisRange;
-
-        if ( lastBlock ) {
-            // Insert the item in the list:
-            newBlock->link = lastBlock->link;
-            lastBlock->link = newBlock;
-        }
-        else if ( block ) {
-            // Head of the linked list:
-            newBlock->link = aSchedule->blocks;
-            SCHEDULE->blocks = newBlock;
+    if ( ! __SScheduleUnitTestCellIsOpen(0) ) {
+        for ( cell = 1; cell <= (unsigned int)allocation.beforeTime; cell++ ) {
+            if ( __SScheduleUnitTestCellIsOpen(cell) ) {
+                allocation.hasFirstStart = true;
+                allocation.firstStart = cell - 1;
+                break;
+            }
         }
-        SCHEDULE->blockCount++;
-        return true;
     }
 
+    allocated = SScheduleAllocateNext(theSchedule, allocation.duration, allocation.beforeTime, count, __SScheduleUnitTestAllocateCallback, &allocation);
+    if ( allocated != allocation.count ) allocation.failures++;
+
     //
-    // We get here after we merged the new block with an existing one;
-    // now we need to make another pass at the list, merging any
-    // subsequent blocks that intersect or are contiguous.
+    // Fewer blocks than requested means no open time is left before beforeTime:
     //
-    block = aSchedule->blocks;
-    while ( block->link ) {
-        //
-        // Contiguous?
-        //
-        if ( STimeRangeIsContiguous(block->period, block->link->period) ) {
-            SScheduleBlock  *nextBlock = block->link;
-            STimeRangeRef   mergedRange = STimeRangeJoin(block->period, nextBlock->period);
-
-            if ( ! mergedRange ) {
-                fprintf(stderr, "FATAL:  unable to allocated merged STimeRange while adding a scheduled block!\n");
-                exit(ENOMEM);
-            }
-            STimeRangeRelease(block->period);
-            block->period = mergedRange;
-            block->link = nextBlock->link;
-            SScheduleBlockDealloc(nextBlock);
-            SCHEDULE->blockCount--;
-        }
-        //
-        // Intersects?
-        //
-        else if ( STimeRangeDoesIntersect(block->period, block->link->period) ) {
-            SScheduleBlock  *nextBlock = block->link;
-            STimeRangeRef   mergedRange = STimeRangeUnion(block->period, nextBlock->period);
-
-            if ( ! mergedRange ) {
-                fprintf(stderr, "FATAL:  unable to allocated merged STimeRange while adding a scheduled block!\n");
-                exit(ENOMEM);
+    if ( allocated < count ) {
+        for ( cell = 0; cell <= (unsigned int)allocation.beforeTime; cell++ ) {
+            if ( __SScheduleUnitTestCellIsOpen(cell) ) {
+                allocation.failures++;
+                break;
             }
-            STimeRangeRelease(block->period);
-            block->period = mergedRange;
-            block->link = nextBlock->link;
-            SScheduleBlockDealloc(nextBlock);
-            SCHEDULE->blockCount--;
-        }
-        //
-        // Move to next block:
-        //
-        else {
-            block = block->link;
         }
     }
-
-    return rc;
+    if ( allocation.failures ) printf("schedule model: op %u: SScheduleAllocateNext(%lld, %lld, %u) disagrees with the model\n",
+                                        op, (long long)allocation.duration, (long long)allocation.beforeTime, count);
+    return allocation.failures;
 }
 
 //
 
-bool
-__SScheduleCreateTables(
-    SSchedule       *aSchedule,
-    sqlite3         *dbHandle
+unsigned int
+__SScheduleUnitTestReload(
+    SScheduleRef    *theSchedule,
+    unsigned int    op
 )
 {
-    int             rc;
-    char*           sqlErrMsg;
-    
     //
-    // Create the schedule table:
+    // Save (a full write the first time, incremental after) and continue with
+    // the schedule read back from the file.  The schedule is released before
+    // the file is read so that closing it can take the file out of WAL mode:
     //
-    rc = sqlite3_exec(
-                dbHandle,
-                "CREATE TABLE schedule ("
-                "  period           TEXT NOT NULL"
-                ")",
-                NULL,
-                NULL,
-                &sqlErrMsg
-            );
-    if ( rc == SQLITE_OK ) {
-        //
-        // Create the blocks table:
-        //
-        rc = sqlite3_exec(
-                    dbHandle,
-                    "CREATE TABLE blocks ("
-                    "  block_id         INTEGER PRIMARY KEY,"
-                    "  period           TEXT UNIQUE NOT NULL"
-                    ")",
-                    NULL,
-                    NULL,
-                    &sqlErrMsg
-                );
-        if ( rc == SQLITE_OK ) {
-            //
-            // Add the default scheduling period record:
-            //
-            rc = sqlite3_exec(
-                        dbHandle,
-                        "INSERT INTO schedule (period) VALUES (':')",
-                        NULL,
-                        NULL,
-                        &sqlErrMsg
-                    );            
-        }
+    SScheduleRef    reloaded;
+    STimeRangeValue period;
+    bool            ok = SScheduleWriteToFile(*theSchedule, SSCHEDULE_UNIT_TEST_MODEL_FILE);
+
+    if ( ! ok ) printf("schedule model: op %u: write failed: %s\n", op, SScheduleGetLastErrorMessage(*theSchedule));
+    SScheduleRelease(*theSchedule);
+    *theSchedule = NULL;
+    if ( ! ok ) return 1;
+    if ( ! (reloaded = SScheduleCreateWithFile(SSCHEDULE_UNIT_TEST_MODEL_FILE)) ) {
+        printf("schedule model: op %u: reload failed\n", op);
+        return 1;
     }
-    if ( rc != SQLITE_OK ) {
-        if ( sqlErrMsg ) {
-            __SScheduleSetLastErrorMessage(aSchedule, "Failure while creating tables in export file (sqlite err = %d): %s", rc, sqlErrMsg);
-            free((void*)sqlErrMsg);
-        } else {
-            __SScheduleSetLastErrorMessage(aSchedule, "Failure while creating tables in export file (sqlite err = %d)", rc);
-        }
-        return false;
+    *theSchedule = reloaded;
+    if ( access(SSCHEDULE_UNIT_TEST_MODEL_FILE "-wal", F_OK) == 0 ) {
+        printf("schedule model: op %u: %s-wal left behind\n", op, SSCHEDULE_UNIT_TEST_MODEL_FILE);
+        return 1;
     }
-    return true;
-}
 
-bool
-SScheduleWriteToFile(
-    SScheduleRef    aSchedule,
-    const char      *filepath
-)
-{
-    SSchedule       *SCHEDULE = (SSchedule*)aSchedule;
-    sqlite3         *dbHandle;
-    struct stat     finfo;
-    int             rc = stat(filepath, &finfo);
-    bool            shouldCreateTables = false;
-    
-    if ( rc == 0 ) {
-        if ( (finfo.st_mode & S_IFREG) ) {
-            rc = sqlite3_open_v2(filepath, &dbHandle, SQLITE_OPEN_READWRITE, NULL);
-        } else {
-            __SScheduleSetLastErrorMessage(SCHEDULE, "Attempt to write schedule to non-file object (st_mode = %x) `%s`", finfo.st_mode, filepath);
-            return false;
-        }
-    } else {
-        shouldCreateTables = true;
-        rc = sqlite3_open_v2(filepath, &dbHandle, SQLITE_OPEN_CREATE | SQLITE_OPEN_READWRITE, NULL);
-    }
-    if ( rc == SQLITE_OK ) {
-        sqlite3_stmt    *sqlQuery;
-        SScheduleBlock  *blocks = aSchedule->blocks;
-        const char      *timeRangeStr, *errorSource;
-        
-        //
-        // Create tables?
-        //
-        if ( shouldCreateTables && ! __SScheduleCreateTables(SCHEDULE, dbHandle) ) goto cleanup;
-        
-        //
-        // Start transaction:
-        //
-        rc = sqlite3_exec(dbHandle, "BEGIN", NULL, NULL, NULL);
-        if ( rc != SQLITE_OK ) { errorSource = "start transaction"; goto cleanup; }
-        
-        //
-        // Update the period:
-        //
-        rc = sqlite3_prepare_v2(
-                    dbHandle,
-                    "UPDATE schedule SET period = ?",
-                    -1,
-                    &sqlQuery,
-                    NULL
-                );
-        if ( rc != SQLITE_OK ) { errorSource = "prepare schedule table update"; goto cleanup; }
-        timeRangeStr = STimeRangeGetCString(aSchedule->period);
-        if ( ! timeRangeStr ) {
-            rc = SQLITE_NOMEM;
-            errorSource = "invalid scheduling period string";
-            goto cleanup;
-        }
-        rc = sqlite3_bind_text(sqlQuery, 1, timeRangeStr, -1, SQLITE_STATIC);
-        if ( rc != SQLITE_OK ) { errorSource = "bind scheduling period string to query"; goto cleanup; }
-        rc = sqlite3_step(sqlQuery);
-        if ( rc != SQLITE_DONE ) { errorSource = "update scheduling period"; goto cleanup; }
-        sqlite3_finalize(sqlQuery);
-        sqlQuery = NULL;
-        
-        //
-        // Delete all rows from the blocks table:
-        //
-        rc = sqlite3_exec(dbHandle, "DELETE FROM blocks", NULL, NULL, NULL);
-        if ( rc != SQLITE_OK ) { errorSource = "scrub scheduled blocks table"; goto cleanup; }
-        
-        //
-        // Prep the blocks insert query:
-        //
-        rc = sqlite3_prepare_v2(
-                    dbHandle,
-                    "INSERT INTO blocks (period) VALUES (?)",
-                    -1,
-                    &sqlQuery,
-                    NULL
-                );
-        if ( rc != SQLITE_OK ) { errorSource = "prepare scheduled blocks table insert"; goto cleanup; }
-        
-        SScheduleBlock  *block = aSchedule->blocks;
-        
-        while ( block ) {
-            timeRangeStr = STimeRangeGetCString(block->period);
-            if ( ! timeRangeStr ) {
-                rc = SQLITE_NOMEM;
-                errorSource = "invalid scheduling period string";
-                goto cleanup;
-            }
-            rc = sqlite3_bind_text(sqlQuery, 1, timeRangeStr, -1, SQLITE_STATIC);
-            if ( rc != SQLITE_OK ) { errorSource = "bind block period string to query"; goto cleanup; }
-            rc = sqlite3_step(sqlQuery);
-            if ( rc != SQLITE_DONE ) { errorSource = "insert into scheduled blocks"; goto cleanup; }
-            rc = sqlite3_reset(sqlQuery);
-            if ( rc != SQLITE_OK ) { errorSource = "reset scheduled blocks query"; goto cleanup; }
-            
-            block = block->link;
-        }
-        sqlite3_finalize(sqlQuery);
-        sqlQuery = NULL;
-        
-        //
-        // Commit the changes:
-        //
-        rc = sqlite3_exec(dbHandle, "COMMIT", NULL, NULL, NULL);
-        if ( rc != SQLITE_OK ) { errorSource = "commit transaction"; goto cleanup; }
-        
-        //
-        // Hooray, we did it!
-        //
-        sqlite3_close_v2(dbHandle);
-        return true;
-        
-cleanup:
-        sqlite3_exec(dbHandle, "ROLLBACK", NULL, NULL, NULL);
-        __SScheduleSetLastErrorMessage(SCHEDULE, "Error at %s for `%s` (sqlite err = %d, %s)\n", errorSource, filepath, rc, sqlite3_errmsg(dbHandle));
-        if ( sqlQuery ) sqlite3_finalize(sqlQuery);
-        sqlite3_close_v2(dbHandle);
-    } else {
-        if ( dbHandle ) {
-            __SScheduleSetLastErrorMessage(SCHEDULE, "Unable to open `%s` (sqlite err = %d, %s)\n", filepath, rc, sqlite3_errmsg(dbHandle));
-            sqlite3_close_v2(dbHandle);
-        } else {
-            __SScheduleSetLastErrorMessage(SCHEDULE, "Unable to open `%s` (sqlite err = %d)\n", filepath, rc);
-        }
+    period = STimeRangeGetValue(SScheduleGetPeriod(reloaded));
+    if ( ! STimeRangeValueIsEqual(&period, &__SScheduleUnitTestPeriod) ) {
+        printf("schedule model: op %u: reloaded period does not match\n", op);
+        return 1;
     }
-    return false;
+    return 0;
 }
 
 //
 
-void
-SScheduleSummarize(
-    SScheduleRef    aSchedule,
-    FILE            *outStream
+int
+__SScheduleUnitTestAgainstModel(
+    unsigned int    count
 )
 {
-    if ( aSchedule ) {
-        SScheduleBlock  *block = aSchedule->blocks;
-        unsigned int    i = 0;
+    //
+    // Drive a schedule with random inserts, bulk merges, removes (including
+    // splits), allocations and save/reload cycles under each kind of period,
+    // checking it against the model after every step.  Ranges handed out by
+    // SScheduleGetBlockAtIndex() must also survive any step that leaves their
+    // block unchanged:
+    //
+    unsigned int    periodKind, op, failures = 0, maxBlockCount = 0;
+
+    srandom(1);
+    for ( periodKind = 0; periodKind < 4; periodKind++ ) {
+        time_t          periodStart = SSCHEDULE_UNIT_TEST_MODEL_MARGIN + random() % SSCHEDULE_UNIT_TEST_MODEL_MARGIN;
+        time_t          periodEnd = SSCHEDULE_UNIT_TEST_MODEL_SPAN - SSCHEDULE_UNIT_TEST_MODEL_MARGIN - 1 - random() % SSCHEDULE_UNIT_TEST_MODEL_MARGIN;
+        STimeRangeRef   period;
+        SScheduleRef    theSchedule;
+
+        switch ( periodKind ) {
+            case 0:
+                __SScheduleUnitTestPeriod = STimeRangeValueMake(periodStart, periodEnd);
+                break;
+            case 1:
+                __SScheduleUnitTestPeriod = STimeRangeValueMakeWithStart(periodStart);
+                break;
+            case 2:
+                __SScheduleUnitTestPeriod = STimeRangeValueMakeWithEnd(periodEnd);
+                break;
+            default:
+                __SScheduleUnitTestPeriod = STimeRangeValueInfinite;
+                break;
+        }
+        memset(__SScheduleUnitTestCells, 0, sizeof(__SScheduleUnitTestCells));
+        unlink(SSCHEDULE_UNIT_TEST_MODEL_FILE);
+
+        period = STimeRangeCreateWithValue(&__SScheduleUnitTestPeriod);
+        theSchedule = SScheduleCreate(period);
+        STimeRangeRelease(period);
+        if ( ! theSchedule ) return ENOMEM;
+
+        for ( op = 0; (op < count) && (failures == 0); op++ ) {
+            unsigned int    blockCount = SScheduleGetBlockCount(theSchedule), i, j, k, which = random() % 100;
+            STimeRangeRef   *heldRanges = calloc(blockCount + 1, sizeof(STimeRangeRef));
+            STimeRangeValue *heldValues = calloc(blockCount + 1, sizeof(STimeRangeValue));
+            STimeRangeValue value;
+            STimeRangeRef   range;
+
+            if ( ! heldRanges || ! heldValues ) return ENOMEM;
+            __SScheduleUnitTestClearMargin(theSchedule);
+            blockCount = SScheduleGetBlockCount(theSchedule);
+            if ( blockCount > maxBlockCount ) maxBlockCount = blockCount;
+            for ( i = 0; i < blockCount; i++ ) {
+                if ( random() % 3 ) {
+                    heldRanges[i] = SScheduleGetBlockAtIndex(theSchedule, i);
+                    heldValues[i] = STimeRangeGetValue(heldRanges[i]);
+                }
+            }
 
-        fprintf(outStream,
-                "SSchedule@%p(%u) {\n"
-                "  period: %s\n"
-                "  blockCount: %u\n",
-                aSchedule, aSchedule->refcount,
-                STimeRangeGetCString(aSchedule->period),
-                aSchedule->blockCount
-            );
-        while ( block ) {
-            fprintf(outStream,"    %d : %s\n", i++, STimeRangeGetCString(block->period));
-            block = block->link;
+            if ( which < 38 ) {
+                value = __SScheduleUnitTestRandomValue(24);
+                range = STimeRangeCreateWithValue(&value);
+                SScheduleAddScheduledBlock(theSchedule, range);
+                STimeRangeRelease(range);
+                __SScheduleUnitTestSetCells(value, true);
+            }
+            else if ( which < 52 ) {
+                value = __SScheduleUnitTestRandomValue(( which < 51 ) ? 40 : 1500);
+                range = STimeRangeCreateWithValue(&value);
+                SScheduleRemoveScheduledBlock(theSchedule, range);
+                STimeRangeRelease(range);
+                __SScheduleUnitTestSetCells(value, false);
+            }
+            else if ( which < 68 ) {
+                STimeRangeValue values[8];
+                STimeRangeRef   ranges[8];
+                unsigned int    valueCount = 1 + random() % 8;
+
+                for ( k = 0; k < valueCount; k++ ) {
+                    values[k] = __SScheduleUnitTestRandomValue(20);
+                    __SScheduleUnitTestSetCells(values[k], true);
+                }
+                if ( which % 2 ) {
+                    SScheduleAddScheduledBlockValues(theSchedule, values, valueCount);
+                } else {
+                    for ( k = 0; k < valueCount; k++ ) ranges[k] = STimeRangeCreateWithValue(&values[k]);
+                    SScheduleAddScheduledBlocks(theSchedule, ranges, valueCount);
+                    for ( k = 0; k < valueCount; k++ ) STimeRangeRelease(ranges[k]);
+                }
+            }
+            else if ( which < 96 ) {
+                failures += __SScheduleUnitTestAllocate(theSchedule, op);
+            }
+            else {
+                bool    isAdd = ( which < 98 );
+
+                value = ( random() % 2 ) ? STimeRangeValueMakeWithStart(__SScheduleUnitTestRandomTime()) : STimeRangeValueMakeWithEnd(__SScheduleUnitTestRandomTime());
+                range = STimeRangeCreateWithValue(&value);
+                if ( isAdd ) {
+                    SScheduleAddScheduledBlock(theSchedule, range);
+                } else {
+                    SScheduleRemoveScheduledBlock(theSchedule, range);
+                }
+                STimeRangeRelease(range);
+                __SScheduleUnitTestSetCells(value, isAdd);
+            }
+
+            //
+            // Every held range whose block is still present unchanged must still
+            // be the range the schedule hands out for it:
+            //
+            for ( i = 0, j = 0, k = SScheduleGetBlockCount(theSchedule); i < blockCount; i++ ) {
+                STimeRangeValue current = STimeRangeValueInvalid;
+
+                if ( ! heldRanges[i] ) continue;
+                while ( j < k ) {
+                    current = STimeRangeGetValue(SScheduleGetBlockAtIndex(theSchedule, j));
+                    if ( __SScheduleUnitTestStartKey(current) >= __SScheduleUnitTestStartKey(heldValues[i]) ) break;
+                    j++;
+                }
+                if ( (j < k) && STimeRangeValueIsEqual(&current, &heldValues[i]) && (SScheduleGetBlockAtIndex(theSchedule, j) != heldRanges[i]) ) {
+                    if ( failures++ < 10 ) printf("schedule model: op %u: range for unchanged block %u was replaced\n", op, i);
+                }
+            }
+            free(heldRanges);
+            free(heldValues);
+
+            if ( (op + 1) % SSCHEDULE_UNIT_TEST_MODEL_SAVE_INTERVAL == 0 ) {
+                failures += __SScheduleUnitTestReload(&theSchedule, op);
+                if ( ! theSchedule ) return 1;
+            }
+            failures += __SScheduleUnitTestCheckModel(theSchedule, op);
         }
-        fprintf(outStream,
-                "  lastErrorMessage: %s\n"
-                "}\n",
-                ( aSchedule->lastErrorMessage ? aSchedule->lastErrorMessage : "<none>" )
-            );
+        SScheduleRelease(theSchedule);
+        unlink(SSCHEDULE_UNIT_TEST_MODEL_FILE);
+        if ( failures ) break;
+    }
+    if ( maxBlockCount < SSCHEDULE_GAP_INDEX_MIN_BLOCKS ) {
+        printf("schedule model: at most %u blocks, too few to exercise the gap index\n", maxBlockCount);
+        failures++;
     }
+    printf("schedule model: %u ops under 4 periods (up to %u blocks), %u failures\n", 4 * count, maxBlockCount, failures);
+    return ( failures == 0 ) ? 0 : 1;
 }
 
 //
 
-#ifdef SSCHEDULE_UNIT_TEST
-
-#include <stdio.h>
-#include <errno.h>
-
 int
-main()
+main(
+    int                 argc,
+    char                *argv[]
+)
 {
-    STimeRangeRef       thePeriod = STimeRangeCreateWithString("20191001T000000-0400:", NULL);
+    STimeRangeRef       thePeriod;
     SScheduleRef        theSchedule;
     int                 outerLoop, outerLoopMax = 1 + (random() % 5), retry = 1 + (random() % 5);
     bool                ok;
-    
+
+    //
+    // "model" runs just the randomized model test:
+    //
+    if ( argc > 1 ) {
+        if ( strcmp(argv[1], "model") == 0 ) return __SScheduleUnitTestAgainstModel(SSCHEDULE_UNIT_TEST_MODEL_OPS);
+        fprintf(stderr, "usage: %s {model}\n", argv[0]);
+        return EINVAL;
+    }
+    if ( __SScheduleUnitTestAgainstModel(SSCHEDULE_UNIT_TEST_MODEL_OPS) ) return 1;
+
+    thePeriod = STimeRangeCreateWithString("20191001T000000-0400:", NULL);
     theSchedule = SScheduleCreateWithFile("dump-schedule.sqlite3db");
     if ( ! theSchedule ) theSchedule = SScheduleCreate(thePeriod);
 
@@ -15,6 +15,13 @@
  * @typedef SScheduleRef
  *
  * Type of a reference to an SSchedule object.
+ *
+ * When built with DTRMGR_ENABLE_ATOMIC_REFCOUNT (the default) SScheduleRetain()
+ * and SScheduleRelease() may be called from any thread.  All other functions
+ * require that a given schedule be used by one thread at a time, queries
+ * included:  lookups update the schedule's search position and block range
+ * cache.  The STimeRange objects a schedule returns may be retained and handed
+ * to other threads.
  */
 typedef struct SSchedule const * SScheduleRef;
 
@@ -33,12 +40,16 @@ SScheduleRef SScheduleCreate(STimeRangeRef period);
  * in filepath (where filepath should point to an SSchedule serialized using
  * SScheduleWriteToFile()).
  *
- * Each scheduled block of time in the file is passed to the
- * SScheduleAddScheduledBlock() so it can be validated and possibly coallesced
- * with other scheduled ranges.  If the veracity of filepath is guaranteed, the
+ * Each scheduled block of time in the file is validated against the scheduling
+ * period and the blocks are then sorted and coallesced as by
+ * SScheduleAddScheduledBlocks().  If the veracity of filepath is guaranteed, the
  * SScheduleCreateWithFileQuick() function can be used to forego these expensive
  * sanity checks.
  *
+ * The SSchedule keeps its connection to filepath open for as long as it exists
+ * (or until it is written to a different file), so saving it back to filepath
+ * with SScheduleWriteToFile() does not reopen the file.
+ *
  * @return A reference to an SSchedule object or NULL if any error occurred.
  */
 SScheduleRef SScheduleCreateWithFile(const char *filepath);
@@ -49,10 +60,13 @@ SScheduleRef SScheduleCreateWithFile(const char *filepath);
  * in filepath (where filepath should point to an SSchedule serialized using
  * SScheduleWriteToFile()).
  *
- * Scheduled blocks of time in the file are used as-is and in the order
- * dictated by the table.  If the veracity of filepath is not guaranteed, the
- * SScheduleCreateWithFile() function should be used to check all incoming
- * date-time ranges.
+ * Scheduled blocks of time in the file are used as-is, only sorted if the
+ * table does not already hold them in order.  If the veracity of filepath is
+ * not guaranteed, the SScheduleCreateWithFile() function should be used to
+ * check all incoming date-time ranges.
+ *
+ * The SSchedule keeps its connection to filepath open, as with
+ * SScheduleCreateWithFile().
  *
  * @return A reference to an SSchedule object or NULL if any error occurred.
  */
@@ -96,11 +110,59 @@ unsigned int SScheduleGetBlockCount(SScheduleRef aSchedule);
  *
  * Retrieve the index-th STimeRange object representing a scheduled block of time.
  *
+ * Blocks are stored inline in an array ordered by start time, so this is a
+ * constant-time lookup.  The STimeRange is materialized on first request and
+ * cached by aSchedule; it remains valid for as long as that block stays in
+ * aSchedule unchanged, even if other blocks are added or removed and its index
+ * shifts.  Once the block is merged, trimmed, or removed the object is released
+ * (retain it to keep it longer).
+ *
  * @return The object's reference to a scheduled time period (caller must NOT release
  *    it), NULL if index is not in range.
  */
 STimeRangeRef SScheduleGetBlockAtIndex(SScheduleRef aSchedule, unsigned int index);
 
+/*!
+ * @function SScheduleContainsTime
+ *
+ * Test whether theTime falls within one of the scheduled blocks of aSchedule.
+ * Blocks are located by binary search, so this is O(log n) in the number of
+ * scheduled blocks.
+ *
+ * @return Boolean true if theTime is scheduled, false otherwise.
+ */
+bool SScheduleContainsTime(SScheduleRef aSchedule, time_t theTime);
+/*!
+ * @function SScheduleGetBlockContainingTime
+ *
+ * Locate the scheduled block of time that contains theTime.  If outIndex is not
+ * NULL, the block's index is returned in it.
+ *
+ * @return The object's reference to the scheduled time period (caller must NOT release
+ *    it, see SScheduleGetBlockAtIndex()), NULL if theTime is not scheduled.
+ */
+STimeRangeRef SScheduleGetBlockContainingTime(SScheduleRef aSchedule, time_t theTime, unsigned int *outIndex);
+/*!
+ * @function SScheduleGetBlockBefore
+ *
+ * Locate the latest scheduled block of time that ends prior to theTime.  If
+ * outIndex is not NULL, the block's index is returned in it.
+ *
+ * @return The object's reference to the scheduled time period (caller must NOT release
+ *    it, see SScheduleGetBlockAtIndex()), NULL if there is no such block.
+ */
+STimeRangeRef SScheduleGetBlockBefore(SScheduleRef aSchedule, time_t theTime, unsigned int *outIndex);
+/*!
+ * @function SScheduleGetBlockAfter
+ *
+ * Locate the earliest scheduled block of time that starts after theTime.  If
+ * outIndex is not NULL, the block's index is returned in it.
+ *
+ * @return The object's reference to the scheduled time period (caller must NOT release
+ *    it, see SScheduleGetBlockAtIndex()), NULL if there is no such block.
+ */
+STimeRangeRef SScheduleGetBlockAfter(SScheduleRef aSchedule, time_t theTime, unsigned int *outIndex);
+
 /*!
  * @function SScheduleGetLastErrorMessage
  *
@@ -148,21 +210,160 @@ STimeRangeRef SScheduleGetNextOpenBlock(SScheduleRef aSchedule);
  */
 STimeRangeRef SScheduleGetNextOpenBlockBeforeTime(SScheduleRef aSchedule, time_t beforeTime);
 
+/*!
+ * @function SScheduleFindOpenBlockOfDuration
+ *
+ * Locate the earliest stretch of unscheduled time in aSchedule that is at least
+ * duration seconds long and lies entirely within [afterTime, beforeTime).  The
+ * open block is trimmed to that window and its bounds are returned in outStart
+ * and outEnd (either may be NULL).
+ *
+ * Large schedules are searched using an index of the gaps between scheduled
+ * blocks.  The index is rebuilt in O(n) on the first query after any change to
+ * the number of scheduled blocks; a change that only stretches or trims a block
+ * updates it in place, so queries cost O(log n) until the block count next
+ * changes.
+ *
+ * @return Boolean true if an open block was found, false otherwise.
+ */
+bool SScheduleFindOpenBlockOfDuration(SScheduleRef aSchedule, time_t duration, time_t afterTime, time_t beforeTime, time_t *outStart, time_t *outEnd);
+
+/*!
+ * @typedef SScheduleAllocateCallback
+ *
+ * Type of the function SScheduleAllocateNext() calls for each block of time it
+ * allocates, with the block's bounds and the caller's context pointer.  Return
+ * false to stop allocating after this block.
+ */
+typedef bool (*SScheduleAllocateCallback)(SScheduleRef aSchedule, time_t start, time_t end, void *context);
+
+/*!
+ * @function SScheduleAllocateNext
+ *
+ * Allocate up to count unscheduled blocks of time of length duration seconds that
+ * end prior to beforeTime, in chronological order.  Each gap in the schedule is
+ * divided from its start (or from its end if it has no lower bound) and the final
+ * block in a gap may be shorter than duration.  This is equivalent to repeatedly
+ * dividing SScheduleGetNextOpenBlockBeforeTime() and adding each piece with
+ * SScheduleAddScheduledBlock(), but the gaps are walked just once.
+ *
+ * The callback is invoked for each block as it is allocated; aSchedule itself is
+ * updated after the last block has been allocated, so the callback must not
+ * modify it.
+ *
+ * @return The number of blocks allocated.
+ */
+unsigned int SScheduleAllocateNext(SScheduleRef aSchedule, time_t duration, time_t beforeTime, unsigned int count, SScheduleAllocateCallback callback, void *context);
+
+/*!
+ * @typedef SScheduleGapIterator
+ *
+ * State for walking the unscheduled blocks of time (gaps) in a schedule in
+ * chronological order.  Initialize with SScheduleGapIteratorInit() and call
+ * SScheduleGapIteratorNext() until it returns false.  The iterator is meant to
+ * live on the stack and performs no allocation.
+ *
+ * After a successful SScheduleGapIteratorNext(), isStartSet and isEndSet indicate
+ * whether the gap has a lower and upper bound, respectively.
+ *
+ * The schedule must not be modified while it is being iterated.
+ */
+typedef struct SScheduleGapIterator {
+    SScheduleRef    schedule;
+    unsigned int    gapIndex, gapIndexEnd;
+    bool            hasWindowStart, hasWindowEnd;
+    time_t          windowStart, windowEnd;
+    bool            isStartSet, isEndSet;
+} SScheduleGapIterator;
+
+/*!
+ * @function SScheduleGapIteratorInit
+ *
+ * Prepare iterator to walk the gaps in aSchedule.  If window is not NULL, only
+ * the portions of gaps that intersect it are produced.
+ */
+void SScheduleGapIteratorInit(SScheduleGapIterator *iterator, SScheduleRef aSchedule, STimeRangeRef window);
+/*!
+ * @function SScheduleGapIteratorNext
+ *
+ * Advance iterator to the next gap.  The bounds of the gap are copied to outStart
+ * and outEnd (either may be NULL); a bound is only set if the corresponding
+ * isStartSet/isEndSet field of iterator is true.
+ *
+ * @return Boolean true if another gap was found, false once iteration is complete.
+ */
+bool SScheduleGapIteratorNext(SScheduleGapIterator *iterator, time_t *outStart, time_t *outEnd);
+
 /*!
  * @function SScheduleAddScheduledBlock
  *
  * Mark as "scheduled" any time in scheduledBlock that intersects the scheduling
  * period of aSchedule.
  *
+ * aSchedule remembers where its last insert or lookup landed and searches
+ * outward from there, so adding blocks in chronological order (as
+ * SScheduleAllocateNext() does) costs amortized constant time per block.
+ *
  * @return Boolean true if scheduledBlock was successfully absorbed, false otherwise.
  */
 bool SScheduleAddScheduledBlock(SScheduleRef aSchedule, STimeRangeRef scheduledBlock);
 
+/*!
+ * @function SScheduleAddScheduledBlocks
+ *
+ * Mark as "scheduled" any time in the scheduledBlockCount ranges in scheduledBlocks
+ * that intersects the scheduling period of aSchedule.  Ranges that do not intersect
+ * the scheduling period are ignored.
+ *
+ * The ranges are sorted and merged with the existing scheduled blocks in a single
+ * pass, which is far cheaper than calling SScheduleAddScheduledBlock() for each.
+ *
+ * @return Boolean true if the ranges were successfully absorbed, false otherwise.
+ */
+bool SScheduleAddScheduledBlocks(SScheduleRef aSchedule, const STimeRangeRef *scheduledBlocks, unsigned int scheduledBlockCount);
+/*!
+ * @function SScheduleAddScheduledBlockValues
+ *
+ * Equivalent to SScheduleAddScheduledBlocks() for ranges held by value, e.g. as
+ * produced by STimeRangeParseBuffer().
+ *
+ * @return Boolean true if the ranges were successfully absorbed, false otherwise.
+ */
+bool SScheduleAddScheduledBlockValues(SScheduleRef aSchedule, const STimeRangeValue *scheduledBlocks, unsigned int scheduledBlockCount);
+
+/*!
+ * @function SScheduleRemoveScheduledBlock
+ *
+ * Mark as "unscheduled" any time in unscheduledBlock that intersects the scheduling
+ * period of aSchedule.  A scheduled block that extends beyond unscheduledBlock on
+ * both sides is split in two.
+ *
+ * The affected blocks are located by binary search in O(log n), where n is the
+ * number of scheduled blocks.  If the removal only trims blocks, the whole call is
+ * O(log n).  If it deletes or splits a block, the later blocks are shifted along
+ * the list, so the call is O(n).  The next SScheduleFindOpenBlockOfDuration() then
+ * also pays O(n) to rebuild its gap index.
+ *
+ * @return Boolean true if the time was successfully removed (or was not scheduled to
+ *    begin with), false otherwise.
+ */
+bool SScheduleRemoveScheduledBlock(SScheduleRef aSchedule, STimeRangeRef unscheduledBlock);
+
 /*!
  * @function SScheduleWriteToFile
  *
  * Serialize aSchedule to an SQLite3 database at filepath.
  *
+ * The connection aSchedule holds is used if it is to filepath; otherwise it is
+ * closed and aSchedule keeps a new connection to filepath instead.
+ *
+ * A file in the older schema (date-time strings rather than integer bounds) is
+ * upgraded in place.
+ *
+ * If filepath is the file aSchedule was last loaded from or written to and
+ * nothing else has modified it since, only the blocks that changed are
+ * written; otherwise the file's blocks are replaced wholesale.
+ *
  * Most failures will set the lastErrorMessage of aSchedule with descriptive (maybe even
  * informative) information about the failure.
  *
@@ -6,11 +6,22 @@
  */
 
 #include "STimeRange.h"
+#include "STimeZone.h"
+
+#include <pthread.h>
+
+#ifdef DTRMGR_ENABLE_ATOMIC_REFCOUNT
+#include <sched.h>
+#endif
+
+#if defined(DTRMGR_ENABLE_SIMD_PARSE) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define STIMERANGE_HAVE_X86_SIMD
+#include <immintrin.h>
+#endif
 
 //
 
 const char *__STimeRangeDateTimeFormat = "%Y%m%dT%H%M%S%z";
-const size_t __STimeRangeDateTimeFormatMaxOutLen = 4 + 2 + 2 + 1 + 2 + 2 + 2 + 5 + 1;
 
 //
 
@@ -21,37 +32,358 @@ STimeRangeJustifyTime(
     bool                    roundUp
 )
 {
-    struct tm               dateTimeComponents;
+    STimeZoneCivilTime      civilTime;
 
-    if ( localtime_r(&theTime, &dateTimeComponents) ) {
-        dateTimeComponents.tm_isdst = -1;
+    //
+    // The civil time keeps its UTC offset, so justifying within an hour that
+    // occurs twice stays in the same occurrence:
+    //
+    if ( STimeZoneTimeToCivil(theTime, &civilTime) ) {
         if ( roundUp ) {
-            if ( dateTimeComponents.tm_sec > 0 ) dateTimeComponents.tm_min++;
-            dateTimeComponents.tm_sec = 0;
+            if ( civilTime.second > 0 ) civilTime.minute++;
+            civilTime.second = 0;
             if ( justifyTo > kSTimeRangeJustifyTimeToMinutes ) {
-                if ( dateTimeComponents.tm_min > 0 ) dateTimeComponents.tm_hour++;
-                dateTimeComponents.tm_min = 0;
+                if ( civilTime.minute > 0 ) civilTime.hour++;
+                civilTime.minute = 0;
                 if ( justifyTo > kSTimeRangeJustifyTimeToHours ) {
-                    if ( dateTimeComponents.tm_hour > 0 ) dateTimeComponents.tm_mday++;
-                    dateTimeComponents.tm_hour = 0;
+                    if ( civilTime.hour > 0 ) civilTime.day++;
+                    civilTime.hour = 0;
                 }
             }
         } else {
-            dateTimeComponents.tm_sec = 0;
+            civilTime.second = 0;
             if ( justifyTo > kSTimeRangeJustifyTimeToMinutes ) {
-                dateTimeComponents.tm_min = 0;
+                civilTime.minute = 0;
                 if ( justifyTo > kSTimeRangeJustifyTimeToHours ) {
-                    dateTimeComponents.tm_hour = 0;
+                    civilTime.hour = 0;
                 }
             }
         }
-        return mktime(&dateTimeComponents);
+        if ( STimeZoneCivilToTime(&civilTime, &theTime) ) return theTime;
     }
     return 0;
 }
 
 //
 
+bool
+__STimeRangeTimeFromComponents(
+    const struct tm     *dateTimeComponents,
+    time_t              *outTimestamp
+)
+{
+    //
+    // Equivalent to mktime() with tm_isdst = -1 for a struct tm filled-in by
+    // strptime():
+    //
+    STimeZoneCivilTime  civilTime = {
+                                .year = (int64_t)dateTimeComponents->tm_year + 1900,
+                                .month = dateTimeComponents->tm_mon + 1,
+                                .day = dateTimeComponents->tm_mday,
+                                .hour = dateTimeComponents->tm_hour,
+                                .minute = dateTimeComponents->tm_min,
+                                .second = dateTimeComponents->tm_sec,
+                                .utcOffset = STIMEZONE_NO_OFFSET_HINT
+                            };
+
+    return STimeZoneCivilToTime(&civilTime, outTimestamp);
+}
+
+//
+// The canonical date-time format is fixed-width with an explicit UTC offset, so
+// it is decoded directly and the civil date converted to epoch seconds
+// arithmetically rather than via strptime() and mktime().
+//
+
+const char*
+__STimeRangeParseDigits(
+    const char  *digitsStr,
+    int         nDigits,
+    int         minValue,
+    int         maxValue,
+    int         *outValue
+)
+{
+    int         value = 0;
+    
+    while ( nDigits-- > 0 ) {
+        if ( ! isdigit((unsigned char)*digitsStr) ) return NULL;
+        value = 10 * value + (*digitsStr++ - '0');
+    }
+    if ( (value < minValue) || (value > maxValue) ) return NULL;
+    *outValue = value;
+    return digitsStr;
+}
+
+const char*
+__STimeRangeParseCanonicalDateTime(
+    const char  *dateTimeStr,
+    time_t      *outTimestamp
+)
+{
+    //
+    // YYYYMMDDTHHMMSS±HH{MM}; returns a pointer to the character following the
+    // date-time or NULL if dateTimeStr isn't in the canonical format:
+    //
+    int         year, month, day, hour, minute, second, offsetHours, offsetMinutes = 0, offsetSign;
+    const char  *p = dateTimeStr;
+    
+    if ( ! (p = __STimeRangeParseDigits(p, 4, 0, 9999, &year)) ) return NULL;
+    if ( ! (p = __STimeRangeParseDigits(p, 2, 1, 12, &month)) ) return NULL;
+    if ( ! (p = __STimeRangeParseDigits(p, 2, 1, 31, &day)) ) return NULL;
+    if ( *p++ != 'T' ) return NULL;
+    if ( ! (p = __STimeRangeParseDigits(p, 2, 0, 23, &hour)) ) return NULL;
+    if ( ! (p = __STimeRangeParseDigits(p, 2, 0, 59, &minute)) ) return NULL;
+    if ( ! (p = __STimeRangeParseDigits(p, 2, 0, 60, &second)) ) return NULL;
+    switch ( *p++ ) {
+        case '+':
+            offsetSign = 1;
+            break;
+        case '-':
+            offsetSign = -1;
+            break;
+        default:
+            return NULL;
+    }
+    if ( ! (p = __STimeRangeParseDigits(p, 2, 0, 23, &offsetHours)) ) return NULL;
+    if ( isdigit((unsigned char)*p) && ! (p = __STimeRangeParseDigits(p, 2, 0, 59, &offsetMinutes)) ) return NULL;
+    
+    *outTimestamp = (time_t)(86400 * STimeZoneDaysFromCivil(year, month, day) + 3600 * hour + 60 * minute + second - offsetSign * (3600 * offsetHours + 60 * offsetMinutes));
+    return p;
+}
+
+//
+
+//
+// A fully-bounded range of canonical date-times with four-digit UTC offsets is
+// fixed-width (STIMERANGE_CANONICAL_RANGE_LEN bytes), so on CPUs that have them
+// vector instructions validate all of its digits at once, pair them up by shuffle,
+// and combine each pair by multiply-add into 16-bit fields that are range checked
+// together.  The fields land in the order:
+//
+//     [ 0.. 6]  start year/100, year%100, month, day, hour, minute, second
+//     [ 8.. 9]  start offset hours, minutes
+//     [11..17]  end year/100, year%100, month, day, hour, minute, second
+//     [18..19]  end offset hours, minutes
+//
+// The kernel is chosen once at startup; the scalar one is the canonical parser.
+//
+
+#define STIMERANGE_CANONICAL_RANGE_LEN  41
+
+typedef bool (*__STimeRangeCanonicalRangeDecoder)(const char *rangeStr, STimeRangeValue *outValue);
+
+bool
+__STimeRangeDecodeCanonicalRangeScalar(
+    const char      *rangeStr,
+    STimeRangeValue *outValue
+)
+{
+    time_t          start, end;
+    const char      *p;
+    
+    if ( ! (p = __STimeRangeParseCanonicalDateTime(rangeStr, &start)) || (*p != ':') ) return false;
+    if ( (__STimeRangeParseCanonicalDateTime(p + 1, &end) != rangeStr + STIMERANGE_CANONICAL_RANGE_LEN) ) return false;
+    *outValue = STimeRangeValueMake(start, end);
+    return true;
+}
+
+#ifdef STIMERANGE_HAVE_X86_SIMD
+
+time_t
+__STimeRangeCanonicalFieldsToTime(
+    const uint16_t  *dateFields,
+    const uint16_t  *offsetFields,
+    char            offsetSign
+)
+{
+    time_t          offset = 3600 * offsetFields[0] + 60 * offsetFields[1];
+    
+    return (time_t)(86400 * STimeZoneDaysFromCivil(100 * dateFields[0] + dateFields[1], dateFields[2], dateFields[3])
+                        + 3600 * dateFields[4] + 60 * dateFields[5] + dateFields[6] - ( offsetSign == '-' ? -offset : offset ));
+}
+
+bool
+__STimeRangeCanonicalLiteralsAreValid(
+    const char      *rangeStr
+)
+{
+    return (rangeStr[8] == 'T') && ((rangeStr[15] == '+') || (rangeStr[15] == '-')) && (rangeStr[20] == ':') &&
+           (rangeStr[29] == 'T') && ((rangeStr[36] == '+') || (rangeStr[36] == '-'));
+}
+
+//
+// The last 16 bytes of the range (offset 25) hold the end date-time's minute,
+// second, and UTC offset; both kernels decode them the same way:
+//
+#define STIMERANGE_SIMD_TAIL_DIGITS     0xF7EF
+#define STIMERANGE_SIMD_TAIL_SHUFFLE    _mm_setr_epi8(7, 8, 9, 10, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1)
+#define STIMERANGE_SIMD_TAIL_MIN        _mm_setzero_si128()
+#define STIMERANGE_SIMD_TAIL_MAX        _mm_setr_epi16(59, 60, 23, 59, 0, 0, 0, 0)
+
+__attribute__((target("sse4.1")))
+bool
+__STimeRangeDecodeCanonicalRangeSSE41(
+    const char      *rangeStr,
+    STimeRangeValue *outValue
+)
+{
+    const __m128i   zero = _mm_set1_epi8('0'), nine = _mm_set1_epi8(9), tensAndOnes = _mm_set1_epi16(0x010A);
+    __m128i         head = _mm_sub_epi8(_mm_loadu_si128((const __m128i*)rangeStr), zero);
+    __m128i         middle = _mm_sub_epi8(_mm_loadu_si128((const __m128i*)(rangeStr + 16)), zero);
+    __m128i         tail = _mm_sub_epi8(_mm_loadu_si128((const __m128i*)(rangeStr + 25)), zero);
+    __m128i         isOutOfRange;
+    uint16_t        fields[24];
+    
+    if ( (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(head, nine), head)) & 0x7EFF) != 0x7EFF ) return false;
+    if ( (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(middle, nine), middle)) & 0xDFEF) != 0xDFEF ) return false;
+    if ( (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(tail, nine), tail)) & STIMERANGE_SIMD_TAIL_DIGITS) != STIMERANGE_SIMD_TAIL_DIGITS ) return false;
+    if ( ! __STimeRangeCanonicalLiteralsAreValid(rangeStr) ) return false;
+    
+    head = _mm_maddubs_epi16(_mm_shuffle_epi8(head, _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 9, 10, 11, 12, 13, 14, -1, -1)), tensAndOnes);
+    middle = _mm_maddubs_epi16(_mm_shuffle_epi8(middle, _mm_setr_epi8(0, 1, 2, 3, -1, -1, 5, 6, 7, 8, 9, 10, 11, 12, 14, 15)), tensAndOnes);
+    tail = _mm_maddubs_epi16(_mm_shuffle_epi8(tail, STIMERANGE_SIMD_TAIL_SHUFFLE), tensAndOnes);
+    
+    isOutOfRange = _mm_or_si128(_mm_cmpgt_epi16(head, _mm_setr_epi16(99, 99, 12, 31, 23, 59, 60, 0)),
+                                _mm_cmpgt_epi16(_mm_setr_epi16(0, 0, 1, 1, 0, 0, 0, 0), head));
+    isOutOfRange = _mm_or_si128(isOutOfRange, _mm_or_si128(_mm_cmpgt_epi16(middle, _mm_setr_epi16(23, 59, 0, 99, 99, 12, 31, 23)),
+                                _mm_cmpgt_epi16(_mm_setr_epi16(0, 0, 0, 0, 0, 1, 1, 0), middle)));
+    isOutOfRange = _mm_or_si128(isOutOfRange, _mm_or_si128(_mm_cmpgt_epi16(tail, STIMERANGE_SIMD_TAIL_MAX),
+                                _mm_cmpgt_epi16(STIMERANGE_SIMD_TAIL_MIN, tail)));
+    if ( ! _mm_testz_si128(isOutOfRange, isOutOfRange) ) return false;
+    
+    _mm_storeu_si128((__m128i*)&fields[0], head);
+    _mm_storeu_si128((__m128i*)&fields[8], middle);
+    _mm_storeu_si128((__m128i*)&fields[16], tail);
+    *outValue = STimeRangeValueMake(__STimeRangeCanonicalFieldsToTime(&fields[0], &fields[8], rangeStr[15]),
+                                    __STimeRangeCanonicalFieldsToTime(&fields[11], &fields[18], rangeStr[36]));
+    return true;
+}
+
+__attribute__((target("avx2")))
+bool
+__STimeRangeDecodeCanonicalRangeAVX2(
+    const char      *rangeStr,
+    STimeRangeValue *outValue
+)
+{
+    //
+    // As the SSE4.1 kernel, but the first 32 bytes are handled in one register
+    // (the shuffle works within each 128-bit lane, so the lanes' controls are
+    // exactly the SSE4.1 kernel's head and middle):
+    //
+    const __m256i   zero = _mm256_set1_epi8('0'), nine = _mm256_set1_epi8(9), tensAndOnes = _mm256_set1_epi16(0x010A);
+    __m256i         headAndMiddle = _mm256_sub_epi8(_mm256_loadu_si256((const __m256i*)rangeStr), zero);
+    __m128i         tail = _mm_sub_epi8(_mm_loadu_si128((const __m128i*)(rangeStr + 25)), _mm_set1_epi8('0'));
+    __m256i         isOutOfRange;
+    __m128i         isTailOutOfRange;
+    uint16_t        fields[24];
+    
+    if ( ((uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_min_epu8(headAndMiddle, nine), headAndMiddle)) & 0xDFEF7EFF) != 0xDFEF7EFF ) return false;
+    if ( (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(tail, _mm_set1_epi8(9)), tail)) & STIMERANGE_SIMD_TAIL_DIGITS) != STIMERANGE_SIMD_TAIL_DIGITS ) return false;
+    if ( ! __STimeRangeCanonicalLiteralsAreValid(rangeStr) ) return false;
+    
+    headAndMiddle = _mm256_maddubs_epi16(_mm256_shuffle_epi8(headAndMiddle, _mm256_setr_epi8(
+                                                0, 1, 2, 3, 4, 5, 6, 7, 9, 10, 11, 12, 13, 14, -1, -1,
+                                                0, 1, 2, 3, -1, -1, 5, 6, 7, 8, 9, 10, 11, 12, 14, 15)), tensAndOnes);
+    tail = _mm_maddubs_epi16(_mm_shuffle_epi8(tail, STIMERANGE_SIMD_TAIL_SHUFFLE), _mm_set1_epi16(0x010A));
+    
+    isOutOfRange = _mm256_or_si256(_mm256_cmpgt_epi16(headAndMiddle, _mm256_setr_epi16(99, 99, 12, 31, 23, 59, 60, 0, 23, 59, 0, 99, 99, 12, 31, 23)),
+                                   _mm256_cmpgt_epi16(_mm256_setr_epi16(0, 0, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 0), headAndMiddle));
+    isTailOutOfRange = _mm_or_si128(_mm_cmpgt_epi16(tail, STIMERANGE_SIMD_TAIL_MAX), _mm_cmpgt_epi16(STIMERANGE_SIMD_TAIL_MIN, tail));
+    if ( ! _mm256_testz_si256(isOutOfRange, isOutOfRange) || ! _mm_testz_si128(isTailOutOfRange, isTailOutOfRange) ) return false;
+    
+    _mm256_storeu_si256((__m256i*)&fields[0], headAndMiddle);
+    _mm_storeu_si128((__m128i*)&fields[16], tail);
+    *outValue = STimeRangeValueMake(__STimeRangeCanonicalFieldsToTime(&fields[0], &fields[8], rangeStr[15]),
+                                    __STimeRangeCanonicalFieldsToTime(&fields[11], &fields[18], rangeStr[36]));
+    return true;
+}
+
+#endif /* STIMERANGE_HAVE_X86_SIMD */
+
+static __STimeRangeCanonicalRangeDecoder __STimeRangeDecodeCanonicalRange = __STimeRangeDecodeCanonicalRangeScalar;
+
+#ifdef STIMERANGE_HAVE_X86_SIMD
+__attribute__((constructor))
+static void
+__STimeRangeSelectCanonicalRangeDecoder(void)
+{
+    //
+    // Runs before main(), so there are no other threads to race:
+    //
+    __builtin_cpu_init();
+    if ( __builtin_cpu_supports("avx2") ) {
+        __STimeRangeDecodeCanonicalRange = __STimeRangeDecodeCanonicalRangeAVX2;
+    } else if ( __builtin_cpu_supports("sse4.1") ) {
+        __STimeRangeDecodeCanonicalRange = __STimeRangeDecodeCanonicalRangeSSE41;
+    }
+}
+#endif
+
+//
+
+const char*
+__STimeRangeParseEpochDateTime(
+    const char  *dateTimeStr,
+    time_t      *outTimestamp
+)
+{
+    //
+    // @{-}<digits> as seconds since the epoch; returns a pointer to the character
+    // following the digits or NULL if dateTimeStr isn't in that form (or the value
+    // doesn't fit in a time_t):
+    //
+    const char  *p = dateTimeStr;
+    bool        isNegative = false;
+    uint64_t    value = 0, limit;
+    
+    if ( *p++ != '@' ) return NULL;
+    if ( *p == '-' ) {
+        isNegative = true;
+        p++;
+    }
+    if ( ! isdigit((unsigned char)*p) ) return NULL;
+    limit = (uint64_t)INT64_MAX + ( isNegative ? 1 : 0 );
+    while ( isdigit((unsigned char)*p) ) {
+        unsigned int    digit = *p++ - '0';
+        
+        if ( value > (limit - digit) / 10 ) return NULL;
+        value = 10 * value + digit;
+    }
+    *outTimestamp = isNegative ? (time_t)(0 - value) : (time_t)value;
+    return p;
+}
+
+//
+
+const char*
+__STimeRangeParseRangeDateTime(
+    const char  *dateTimeStr,
+    time_t      *outTimestamp
+)
+{
+    const char  *endptr;
+    
+    if ( *dateTimeStr == '@' ) return __STimeRangeParseEpochDateTime(dateTimeStr, outTimestamp);
+    
+    endptr = __STimeRangeParseCanonicalDateTime(dateTimeStr, outTimestamp);
+    if ( ! endptr ) {
+        //
+        // Not fixed-width, let the C library have a go at it:
+        //
+        struct tm   parsed_time;
+        
+        memset(&parsed_time, 0, sizeof(parsed_time));
+        endptr = strptime(dateTimeStr, __STimeRangeDateTimeFormat, &parsed_time);
+        if ( (endptr == NULL) || (endptr == dateTimeStr) ) return NULL;
+        if ( ! __STimeRangeTimeFromComponents(&parsed_time, outTimestamp) ) return NULL;
+    }
+    return endptr;
+}
+
+//
+
 const char* const STimeRangeParseFormats[] = {
         "%Y%m%dT%H%M%S%z",
         "%Y%m%dT%H%M%S",
@@ -88,11 +420,26 @@ STimeRangeParseDateAndTime(
     }
 
     const char* const   *formats = STimeRangeParseFormats;
+    time_t              timestamp;
 
+    //
+    // The epoch and canonical formats are decoded directly; the looser formats go
+    // through the C library:
+    //
+    if ( (endptr = (char*)__STimeRangeParseEpochDateTime(dateTimeStr, &timestamp)) && ! *endptr ) {
+        if ( outTimestamp ) *outTimestamp = timestamp;
+        return true;
+    }
+    if ( (endptr = (char*)__STimeRangeParseCanonicalDateTime(dateTimeStr, &timestamp)) && ! *endptr ) {
+        if ( outTimestamp ) *outTimestamp = timestamp;
+        return true;
+    }
     while ( *formats ) {
-        endptr = strptime(dateTimeStr, __STimeRangeDateTimeFormat, &dateTimeComponents);
-        if ( endptr <= dateTimeStr ) {
-            if ( outTimestamp ) *outTimestamp = mktime(&dateTimeComponents);
+        memset(&dateTimeComponents, 0, sizeof(dateTimeComponents));
+        endptr = strptime(dateTimeStr, *formats, &dateTimeComponents);
+        if ( endptr && ! *endptr ) {
+            if ( ! __STimeRangeTimeFromComponents(&dateTimeComponents, &timestamp) ) return false;
+            if ( outTimestamp ) *outTimestamp = timestamp;
             return true;
         }
         formats++;
@@ -105,13 +452,14 @@ STimeRangeParseDateAndTime(
 enum {
     kSTimeRangeIsStatic         = 1 << 0,
     kSTimeRangeIsConst          = 1 << 1,
-    kSTimeRangeIsValid          = 1 << 2,
-    kSTimeRangeHasLowerBound    = 1 << 3,
-    kSTimeRangeHasUpperBound    = 1 << 4,
+    kSTimeRangeIsValid          = kSTimeRangeValueIsValid,
+    kSTimeRangeHasLowerBound    = kSTimeRangeValueHasLowerBound,
+    kSTimeRangeHasUpperBound    = kSTimeRangeValueHasUpperBound,
     kSTimeRangeOptionMax,
     kSTimeRangeOptionMin        = kSTimeRangeIsStatic,
     //
-    kSTimeRangeBoundsMask       = kSTimeRangeHasLowerBound | kSTimeRangeHasUpperBound
+    kSTimeRangeBoundsMask       = kSTimeRangeHasLowerBound | kSTimeRangeHasUpperBound,
+    kSTimeRangeValueMask        = kSTimeRangeIsValid | kSTimeRangeBoundsMask
 };
 
 const char* __STimeRangeOptionNames[] = {
@@ -122,11 +470,26 @@ const char* __STimeRangeOptionNames[] = {
         "upper-bound"
     };
 
+#ifdef DTRMGR_ENABLE_ATOMIC_REFCOUNT
+//
+// A shared object's string may be requested by several threads at once:  the
+// first to claim the buffer formats it while the others wait.
+//
+enum {
+    kSTimeRangeCStringIsUnformatted = 0,
+    kSTimeRangeCStringIsFormatting,
+    kSTimeRangeCStringIsReady
+};
+#endif
+
 typedef struct STimeRange {
-    uint32_t    refcount;
+    SRefCount   refcount;
     time_t      start, end;
     uint32_t    options;
-    const char  *cstr;
+#ifdef DTRMGR_ENABLE_ATOMIC_REFCOUNT
+    atomic_uint cstrState;
+#endif
+    char        cstr[STIMERANGE_CSTRING_MAX];
 } STimeRange;
 
 //
@@ -136,6 +499,9 @@ const STimeRange __STimeRangeInvalid = {
                             .start = 0,
                             .end = 0,
                             .options = kSTimeRangeIsStatic | kSTimeRangeIsConst,
+#ifdef DTRMGR_ENABLE_ATOMIC_REFCOUNT
+                            .cstrState = kSTimeRangeCStringIsReady,
+#endif
                             .cstr = "<invalid>"
                         };
 const STimeRangeRef STimeRangeInvalid = (STimeRangeRef)&__STimeRangeInvalid;
@@ -145,64 +511,101 @@ const STimeRange __STimeRangeInfinite = {
                             .start = 0,
                             .end = 0,
                             .options = kSTimeRangeIsStatic | kSTimeRangeIsConst | kSTimeRangeIsValid,
+#ifdef DTRMGR_ENABLE_ATOMIC_REFCOUNT
+                            .cstrState = kSTimeRangeCStringIsReady,
+#endif
                             .cstr = "-"
                         };
 const STimeRangeRef STimeRangeInfinite = (STimeRangeRef)&__STimeRangeInfinite;
 
 //
 
-#ifndef STIMERANGE_QUICKSTORE_CAPACITY
-#define STIMERANGE_QUICKSTORE_CAPACITY 32
+#ifndef STIMERANGE_POOL_CAPACITY
+#define STIMERANGE_POOL_CAPACITY 256
 #endif
 
-static unsigned int __STimeRangeQuickStoreCapacity = STIMERANGE_QUICKSTORE_CAPACITY;
-static STimeRange __STimeRangeQuickStore[STIMERANGE_QUICKSTORE_CAPACITY];
-static bool __STimeRangeQuickStoreMark[STIMERANGE_QUICKSTORE_CAPACITY];
-static unsigned int __STimeRangeQuickStoreAllocateCount = 0;
-static bool __STimeRangeQuickStoreIsInited = false;
+//
+// Released STimeRange objects are kept on a per-thread free list for reuse, so
+// allocation and deallocation are usually a pop and a push with no locking.  A
+// list holds at most STIMERANGE_POOL_CAPACITY objects; past that they go back
+// to free(), so a thread that releases more ranges than it allocates (e.g. the
+// consumer of ranges created on another thread) can't hoard memory.  A thread's
+// list is emptied when the thread exits.
+//
+
+typedef union __STimeRangePoolSlot {
+    STimeRange                      range;
+    union __STimeRangePoolSlot      *next;
+} __STimeRangePoolSlot;
+
+static _Thread_local __STimeRangePoolSlot *__STimeRangePoolFreeList = NULL;
+static _Thread_local unsigned int __STimeRangePoolFreeCount = 0;
+static _Thread_local bool __STimeRangePoolIsRegistered = false;
+
+static pthread_key_t __STimeRangePoolKey;
+static pthread_once_t __STimeRangePoolKeyOnce = PTHREAD_ONCE_INIT;
 
 void
-__STimeRangeQuickStoreInit(void)
+__STimeRangePoolDrain(
+    void                    *unused
+)
 {
-    if ( ! __STimeRangeQuickStoreIsInited ) {
-        unsigned int    i = 0;
-
-        while ( i < STIMERANGE_QUICKSTORE_CAPACITY ) __STimeRangeQuickStoreMark[i++] = false;
-        __STimeRangeQuickStoreIsInited = true;
+    (void)unused;
+    while ( __STimeRangePoolFreeList ) {
+        __STimeRangePoolSlot    *slot = __STimeRangePoolFreeList;
+        
+        __STimeRangePoolFreeList = slot->next;
+        free((void*)slot);
     }
+    __STimeRangePoolFreeCount = 0;
+    __STimeRangePoolIsRegistered = false;
+}
+
+void
+__STimeRangePoolCreateKey(void)
+{
+    pthread_key_create(&__STimeRangePoolKey, __STimeRangePoolDrain);
 }
 
 STimeRange*
-__STimeRangeQuickStoreAlloc(void)
-{
-    if ( __STimeRangeQuickStoreAllocateCount < STIMERANGE_QUICKSTORE_CAPACITY ) {
-        unsigned int    i = 0;
-
-        __STimeRangeQuickStoreInit();
-        while ( i < STIMERANGE_QUICKSTORE_CAPACITY ) {
-            if ( ! __STimeRangeQuickStoreMark[i] ) {
-                __STimeRangeQuickStoreMark[i] = true;
-                __STimeRangeQuickStoreAllocateCount++;
-                __STimeRangeQuickStore[i].options = kSTimeRangeIsStatic;
-                return &__STimeRangeQuickStore[i];
-            }
-            i++;
-        }
+__STimeRangePoolAlloc(void)
+{
+    __STimeRangePoolSlot    *slot = __STimeRangePoolFreeList;
+
+    if ( slot ) {
+        __STimeRangePoolFreeList = slot->next;
+        __STimeRangePoolFreeCount--;
+    } else if ( ! (slot = malloc(sizeof(__STimeRangePoolSlot))) ) {
+        return NULL;
     }
-    return NULL;
+    slot->range.options = kSTimeRangeIsStatic;
+    return &slot->range;
 }
 
 void
-__STimeRangeQuickStoreDealloc(
+__STimeRangePoolDealloc(
     STimeRange  *aTimeRange
 )
 {
-    unsigned int    i = aTimeRange - &__STimeRangeQuickStore[0];
+    __STimeRangePoolSlot    *slot = (__STimeRangePoolSlot*)aTimeRange;
 
-    if ( i < STIMERANGE_QUICKSTORE_CAPACITY ) {
-        __STimeRangeQuickStoreMark[i] = false;
-        __STimeRangeQuickStoreAllocateCount--;
+    if ( __STimeRangePoolFreeCount >= STIMERANGE_POOL_CAPACITY ) {
+        free((void*)slot);
+        return;
+    }
+    
+    //
+    // The first object a thread keeps arranges for its list to be drained when
+    // the thread exits (the key's value just has to be non-NULL):
+    //
+    if ( ! __STimeRangePoolIsRegistered ) {
+        pthread_once(&__STimeRangePoolKeyOnce, __STimeRangePoolCreateKey);
+        pthread_setspecific(__STimeRangePoolKey, (void*)&__STimeRangePoolIsRegistered);
+        __STimeRangePoolIsRegistered = true;
     }
+    slot->next = __STimeRangePoolFreeList;
+    __STimeRangePoolFreeList = slot;
+    __STimeRangePoolFreeCount++;
 }
 
 //
@@ -210,15 +613,14 @@ __STimeRangeQuickStoreDealloc(
 STimeRange*
 __STimeRangeAlloc(void)
 {
-    STimeRange  *newRange = __STimeRangeQuickStoreAlloc();
+    STimeRange  *newRange = __STimeRangePoolAlloc();
 
-    if ( ! newRange ) {
-        newRange = malloc(sizeof(STimeRange));
-        if ( newRange ) newRange->options = 0;
-    }
     if ( newRange ) {
-        newRange->refcount = 1;
-        newRange->cstr = NULL;
+        SREFCOUNT_INIT(newRange->refcount, 1);
+#ifdef DTRMGR_ENABLE_ATOMIC_REFCOUNT
+        atomic_init(&newRange->cstrState, kSTimeRangeCStringIsUnformatted);
+#endif
+        newRange->cstr[0] = '\0';
     }
     return newRange;
 }
@@ -230,14 +632,7 @@ __STimeRangeDealloc(
     STimeRange  *aTimeRange
 )
 {
-    if ( aTimeRange->cstr ) {
-        free((void*)aTimeRange->cstr);
-    }
-    if ( (aTimeRange->options & kSTimeRangeIsStatic) ) {
-        __STimeRangeQuickStoreDealloc(aTimeRange);
-    } else {
-        free((void*)aTimeRange);
-    }
+    __STimeRangePoolDealloc(aTimeRange);
 }
 
 //
@@ -247,37 +642,36 @@ __STimeRangeGetCString(
     STimeRange  *aTimeRange
 )
 {
-    if ( ! aTimeRange->cstr ) {
-        struct tm       unparsed_time;
-
-        if ( (aTimeRange->options & kSTimeRangeHasLowerBound) ) {
-
-            if ( (aTimeRange->options & kSTimeRangeHasUpperBound) ) {
-                char    buffer[2 * __STimeRangeDateTimeFormatMaxOutLen];
-
-                strftime(buffer, __STimeRangeDateTimeFormatMaxOutLen, __STimeRangeDateTimeFormat, localtime_r(&aTimeRange->start, &unparsed_time));
-                buffer[__STimeRangeDateTimeFormatMaxOutLen - 1] = ':';
-                strftime(buffer + __STimeRangeDateTimeFormatMaxOutLen, __STimeRangeDateTimeFormatMaxOutLen, __STimeRangeDateTimeFormat, localtime_r(&aTimeRange->end, &unparsed_time));
-                aTimeRange->cstr = strdup(buffer);
-            } else {
-                char    buffer[1 + __STimeRangeDateTimeFormatMaxOutLen];
-
-                strftime(buffer, __STimeRangeDateTimeFormatMaxOutLen, __STimeRangeDateTimeFormat, localtime_r(&aTimeRange->start, &unparsed_time));
-                buffer[__STimeRangeDateTimeFormatMaxOutLen - 1] = ':';
-                buffer[__STimeRangeDateTimeFormatMaxOutLen] = '\0';
-                aTimeRange->cstr = strdup(buffer);
-            }
-        } else if ( (aTimeRange->options & kSTimeRangeHasUpperBound) ) {
-            char    buffer[1 + __STimeRangeDateTimeFormatMaxOutLen];
-            buffer[0] = ':';
-            strftime(buffer + 1, __STimeRangeDateTimeFormatMaxOutLen, __STimeRangeDateTimeFormat, localtime_r(&aTimeRange->end, &unparsed_time));
-            aTimeRange->cstr = strdup(buffer);
+    //
+    // The string is formatted into the object's own buffer on first request; a
+    // formatted range is never empty, so an empty buffer means "not yet":
+    //
+#ifdef DTRMGR_ENABLE_ATOMIC_REFCOUNT
+    if ( atomic_load_explicit(&aTimeRange->cstrState, memory_order_acquire) != kSTimeRangeCStringIsReady ) {
+        unsigned int    expected = kSTimeRangeCStringIsUnformatted;
+        
+        if ( atomic_compare_exchange_strong_explicit(&aTimeRange->cstrState, &expected, kSTimeRangeCStringIsFormatting, memory_order_acquire, memory_order_acquire) ) {
+            STimeRangeValue aValue = STimeRangeGetValue(aTimeRange);
+            
+            STimeRangeValueFormat(&aValue, aTimeRange->cstr, sizeof(aTimeRange->cstr));
+            atomic_store_explicit(&aTimeRange->cstrState, kSTimeRangeCStringIsReady, memory_order_release);
         } else {
-            /* infinite time range */
-            aTimeRange->cstr = strdup("-");
+            //
+            // Another thread is formatting the string; formatting takes a few
+            // microseconds at most, but that thread may have been descheduled so
+            // give up the CPU rather than spinning:
+            //
+            while ( atomic_load_explicit(&aTimeRange->cstrState, memory_order_acquire) != kSTimeRangeCStringIsReady ) sched_yield();
         }
     }
-    return ( aTimeRange->cstr ? aTimeRange->cstr : "" );
+#else
+    if ( ! aTimeRange->cstr[0] ) {
+        STimeRangeValue aValue = STimeRangeGetValue(aTimeRange);
+        
+        STimeRangeValueFormat(&aValue, aTimeRange->cstr, sizeof(aTimeRange->cstr));
+    }
+#endif
+    return aTimeRange->cstr;
 }
 
 //
@@ -296,7 +690,7 @@ __STimeRangeDebug(
             "  start: %lld\n"
             "  end: %lld\n"
             "  options: ",
-            aTimeRange, aTimeRange->refcount,
+            aTimeRange, SREFCOUNT_GET(aTimeRange->refcount),
             (long long int)aTimeRange->start,
             (long long int)aTimeRange->end
         );
@@ -384,58 +778,14 @@ STimeRangeCreateWithStartAndDuration(
 
 STimeRangeRef
 STimeRangeCreateWithString(
-    const char  *timeRangeStr,
-    const char* *outEndPtr
+    const char      *timeRangeStr,
+    const char*     *outEndPtr
 )
 {
-    STimeRangeRef   newRange = NULL;
-    time_t          start, end;
-    bool            isStartSet = false, isEndSet = false;
-    struct tm       parsed_time;
-
-    while ( isspace(*timeRangeStr) ) timeRangeStr++;
-
-    if ( *timeRangeStr != ':' ) {
-        /*
-         * the string doesn't lead with a colon, so it has a start date-time
-         */
-        const char  *endptr = strptime(timeRangeStr, __STimeRangeDateTimeFormat, &parsed_time);
-
-        if ( (endptr == NULL) || (endptr == timeRangeStr) ) return STimeRangeInvalid;
-        timeRangeStr = endptr;
-        // Dunno about DST...
-        parsed_time.tm_isdst = -1;
-        start = mktime(&parsed_time);
-        isStartSet = true;
-    }
-    if ( *timeRangeStr == ':' ) {
-        /*
-         * there's a colon, so check for a trailing end date-time
-         */
-        if ( *(++timeRangeStr) ) {
-            const char  *endptr = strptime(timeRangeStr, __STimeRangeDateTimeFormat, &parsed_time);
-
-            if ( (endptr == NULL) || (endptr == timeRangeStr) ) return STimeRangeInvalid;
-            timeRangeStr = endptr;
-            // Dunno about DST...
-            parsed_time.tm_isdst = -1;
-            end = mktime(&parsed_time);
-            isEndSet = true;
-        }
-    }
-    if ( outEndPtr) *outEndPtr = timeRangeStr;
-    if ( isStartSet ) {
-        if ( isEndSet ) {
-            newRange = STimeRangeCreate(start, end);
-        } else {
-            newRange = STimeRangeCreateWithStart(start);
-        }
-    } else if ( isEndSet ) {
-        newRange = STimeRangeCreateWithEnd(end);
-    } else {
-        newRange = STimeRangeInfinite;
-    }
-    return newRange;
+    STimeRangeValue parsedValue;
+    
+    if ( ! STimeRangeValueParse(timeRangeStr, &parsedValue, outEndPtr) ) return STimeRangeInvalid;
+    return STimeRangeCreateWithValue(&parsedValue);
 }
 
 //
@@ -448,7 +798,7 @@ STimeRangeCopy(
     STimeRange      *newRange = __STimeRangeAlloc();
 
     if ( newRange ) {
-        newRange->refcount = 1;
+        SREFCOUNT_INIT(newRange->refcount, 1);
         newRange->start = aTimeRange->start;
         newRange->end = aTimeRange->end;
         newRange->options |= (aTimeRange->options & ~(kSTimeRangeIsStatic | kSTimeRangeIsConst));
@@ -466,7 +816,7 @@ STimeRangeRelease(
     if ( ! (aTimeRange->options & kSTimeRangeIsConst) ) {
         STimeRange  *mutableTimeRange = (STimeRange*)aTimeRange;
 
-        if ( --mutableTimeRange->refcount == 0 ) __STimeRangeDealloc(mutableTimeRange);
+        if ( SREFCOUNT_RELEASE(mutableTimeRange->refcount) ) __STimeRangeDealloc(mutableTimeRange);
     }
 }
 
@@ -478,7 +828,7 @@ STimeRangeRetain(
     if ( ! (aTimeRange->options & kSTimeRangeIsConst) ) {
         STimeRange  *mutableTimeRange = (STimeRange*)aTimeRange;
 
-        mutableTimeRange->refcount++;
+        SREFCOUNT_RETAIN(mutableTimeRange->refcount);
     }
     return aTimeRange;
 }
@@ -549,10 +899,9 @@ STimeRangeContainsTime(
     time_t          theTime
 )
 {
-    if ( ! (aTimeRange->options & kSTimeRangeIsValid) ) return false;
-    if ( (aTimeRange->options & kSTimeRangeHasLowerBound) && theTime < aTimeRange->start ) return false;
-    if ( (aTimeRange->options & kSTimeRangeHasUpperBound) && theTime > aTimeRange->end ) return false;
-    return true;
+    STimeRangeValue aValue = STimeRangeGetValue(aTimeRange);
+    
+    return STimeRangeValueContainsTime(&aValue, theTime);
 }
 
 //
@@ -590,10 +939,9 @@ STimeRangeIsEqual(
     STimeRangeRef   anotherTimeRange
 )
 {
-    return  ( (aTimeRange->options & kSTimeRangeIsValid) && (anotherTimeRange->options & kSTimeRangeIsValid) &&
-             ((aTimeRange->options & kSTimeRangeBoundsMask) == (anotherTimeRange->options & kSTimeRangeBoundsMask)) &&
-             (aTimeRange->start == anotherTimeRange->start) &&  (aTimeRange->end == anotherTimeRange->end)
-            );
+    STimeRangeValue aValue = STimeRangeGetValue(aTimeRange), anotherValue = STimeRangeGetValue(anotherTimeRange);
+    
+    return STimeRangeValueIsEqual(&aValue, &anotherValue);
 }
 
 bool
@@ -602,58 +950,9 @@ STimeRangeDoesIntersect(
     STimeRangeRef   anotherTimeRange
 )
 {
-    if ( (aTimeRange->options & kSTimeRangeIsValid) && (anotherTimeRange->options & kSTimeRangeIsValid) ) {
-        /* Find the earliest date-time: */
-        if ( (aTimeRange->options & kSTimeRangeHasLowerBound) ) {
-            /* aTimeRange has a finite start date-time, so we need to check anotherTimeRange
-             * for the same
-             */
-            if ( (anotherTimeRange->options & kSTimeRangeHasLowerBound) ) {
-                /* both have a start time, so which one is first? */
-                if ( aTimeRange->start < anotherTimeRange->start ) {
-                    /* check for anotherTimeRange.start before aTimeRange->end */
-                    if ( (aTimeRange->options & kSTimeRangeHasUpperBound) ) {
-                        if ( anotherTimeRange->start <= aTimeRange->end ) return true;
-                    } else {
-                        /* aTimeRange is inifinite, so anotherTimeRange definitely intersects */
-                        return true;
-                    }
-                } else {
-                    /* check for aTimeRange.start before anotherTimeRange->end */
-                    if ( (anotherTimeRange->options & kSTimeRangeHasUpperBound) ) {
-                        if ( aTimeRange->start <= anotherTimeRange->end ) return true;
-                    } else {
-                        /* anotherTimeRange is inifinite, so aTimeRange definitely intersects */
-                        return true;
-                    }
-                }
-            } else {
-                /* anotherTimeRange has not finite start time, so we need to check
-                 * that aTimeRange->start is before anotherTimeRange->end
-                 */
-                if ( (anotherTimeRange->options & kSTimeRangeHasUpperBound) ) {
-                    if ( aTimeRange->start <= anotherTimeRange->end ) return true;
-                } else {
-                    /* anotherTimeRange is inifinite, so aTimeRange definitely intersects */
-                    return true;
-                }
-            }
-        } else if ( (anotherTimeRange->options & kSTimeRangeHasLowerBound) ) {
-            /* anotherTimeRange has a finite start date-time, aTimeRange does not
-             * so we need to check that anotherTimeRange->start is before aTimeRange->end
-             */
-            if ( (aTimeRange->options & kSTimeRangeHasUpperBound) ) {
-                if ( anotherTimeRange->start <= aTimeRange->end ) return true;
-            } else {
-                /* aTimeRange is inifinite, so anotherTimeRange definitely intersects */
-                return true;
-            }
-        } else {
-            /* neither have a finite start time so there's intersection no matter what */
-            return true;
-        }
-    }
-    return false;
+    STimeRangeValue aValue = STimeRangeGetValue(aTimeRange), anotherValue = STimeRangeGetValue(anotherTimeRange);
+    
+    return STimeRangeValueDoesIntersect(&aValue, &anotherValue);
 }
 
 bool
@@ -662,21 +961,9 @@ STimeRangeIsContained(
     STimeRangeRef   inAnotherTimeRange
 )
 {
-    if ( (aTimeRange->options & kSTimeRangeIsValid) && (inAnotherTimeRange->options & kSTimeRangeIsValid) ) {
-        if ( (inAnotherTimeRange->options & kSTimeRangeHasLowerBound) ) {
-            /* aTimeRange must have a start date-time >= inAnotherTimeRange->start */
-            if ( ! (aTimeRange->options & kSTimeRangeHasLowerBound) || (aTimeRange->start < inAnotherTimeRange->start) ) return false;
-        }
-        /* inAnotherTimeRange has no finite start date-time, so aTimeRange->start
-         * MUST be >= that, no else clause necessary
-        */
-        if ( (inAnotherTimeRange->options & kSTimeRangeHasUpperBound) ) {
-            /* aTimeRange must have an end date-time <= inAnotherTimeRange->end */
-            if ( ! (aTimeRange->options & kSTimeRangeHasUpperBound) || (aTimeRange->end > inAnotherTimeRange->end) ) return false;
-        }
-        return true;
-    }
-    return false;
+    STimeRangeValue aValue = STimeRangeGetValue(aTimeRange), inAnotherValue = STimeRangeGetValue(inAnotherTimeRange);
+    
+    return STimeRangeValueIsContained(&aValue, &inAnotherValue);
 }
 
 bool
@@ -685,16 +972,9 @@ STimeRangeIsContiguous(
     STimeRangeRef   anotherTimeRange
 )
 {
-    if ( (aTimeRange->options & kSTimeRangeIsValid) && (anotherTimeRange->options & kSTimeRangeIsValid) ) {
-        /* the start of one must be the end of the other + 1 */
-        if ( (aTimeRange->options & kSTimeRangeHasUpperBound) && (anotherTimeRange->options & kSTimeRangeHasLowerBound) ) {
-            if ( aTimeRange->end + 1 == anotherTimeRange->start ) return true;
-        }
-        if ( (aTimeRange->options & kSTimeRangeHasLowerBound) && (anotherTimeRange->options & kSTimeRangeHasUpperBound) ) {
-            if ( anotherTimeRange->end + 1 == aTimeRange->start ) return true;
-        }
-    }
-    return false;
+    STimeRangeValue aValue = STimeRangeGetValue(aTimeRange), anotherValue = STimeRangeGetValue(anotherTimeRange);
+    
+    return STimeRangeValueIsContiguous(&aValue, &anotherValue);
 }
 
 //
@@ -731,62 +1011,10 @@ STimeRangeIntersection(
     STimeRangeRef   anotherTimeRange
 )
 {
-    STimeRangeRef   outRange = STimeRangeInvalid;
-
-    if ( STimeRangeDoesIntersect(aTimeRange, anotherTimeRange) ) {
-        time_t      start, end;
-        bool        isStartSet = false, isEndSet = false;
-
-        /* find maximum start time */
-        if ( (aTimeRange->options & kSTimeRangeHasLowerBound) ) {
-            if ( (anotherTimeRange->options & kSTimeRangeHasLowerBound) ) {
-                if ( aTimeRange->start <= anotherTimeRange->start ) {
-                    start = anotherTimeRange->start;
-                } else {
-                    start = aTimeRange->start;
-                }
-                isStartSet = true;
-            } else {
-                start = aTimeRange->start;
-                isStartSet = true;
-            }
-        } else if ( (anotherTimeRange->options & kSTimeRangeHasLowerBound) ) {
-            start = anotherTimeRange->start;
-            isStartSet = true;
-        }
-
-        /* find minimum end time */
-        if ( (aTimeRange->options & kSTimeRangeHasUpperBound) ) {
-            if ( (anotherTimeRange->options & kSTimeRangeHasUpperBound) ) {
-                if ( aTimeRange->end <= anotherTimeRange->end ) {
-                    end = aTimeRange->end;
-                } else {
-                    end = anotherTimeRange->end;
-                }
-                isEndSet = true;
-            } else {
-                end = aTimeRange->end;
-                isEndSet = true;
-            }
-        } else if ( (anotherTimeRange->options & kSTimeRangeHasUpperBound) ) {
-            end = anotherTimeRange->end;
-            isEndSet = true;
-        }
-
-        /* create accordingly */
-        if ( isStartSet ) {
-            if ( isEndSet ) {
-                outRange = STimeRangeCreate(start, end);
-            } else {
-                outRange = STimeRangeCreateWithStart(start);
-            }
-        } else if ( isEndSet ) {
-            outRange = STimeRangeCreateWithEnd(end);
-        } else {
-            outRange = STimeRangeInfinite;
-        }
-    }
-    return outRange;
+    STimeRangeValue aValue = STimeRangeGetValue(aTimeRange), anotherValue = STimeRangeGetValue(anotherTimeRange);
+    STimeRangeValue outValue = STimeRangeValueIntersection(&aValue, &anotherValue);
+    
+    return STimeRangeCreateWithValue(&outValue);
 }
 
 //
@@ -797,46 +1025,10 @@ STimeRangeUnion(
     STimeRangeRef   anotherTimeRange
 )
 {
-    STimeRangeRef   outRange = STimeRangeInvalid;
-
-    if ( STimeRangeDoesIntersect(aTimeRange, anotherTimeRange) ) {
-        time_t      start, end;
-        bool        isStartSet = false, isEndSet = false;
-
-        /* find minimum start time */
-        if ( (aTimeRange->options & kSTimeRangeHasLowerBound) && (anotherTimeRange->options & kSTimeRangeHasLowerBound) ) {
-            if ( aTimeRange->start <= anotherTimeRange->start ) {
-                start = aTimeRange->start;
-            } else {
-                start = anotherTimeRange->start;
-            }
-            isStartSet = true;
-        }
-
-        /* find maximum end time */
-        if ( (aTimeRange->options & kSTimeRangeHasUpperBound) && (anotherTimeRange->options & kSTimeRangeHasUpperBound) ) {
-            if ( aTimeRange->end <= anotherTimeRange->end ) {
-                end = anotherTimeRange->end;
-            } else {
-                end = aTimeRange->end;
-            }
-            isEndSet = true;
-        }
-
-        /* create accordingly */
-        if ( isStartSet ) {
-            if ( isEndSet ) {
-                outRange = STimeRangeCreate(start, end);
-            } else {
-                outRange = STimeRangeCreateWithStart(start);
-            }
-        } else if ( isEndSet ) {
-            outRange = STimeRangeCreateWithEnd(end);
-        } else {
-            outRange = STimeRangeInfinite;
-        }
-    }
-    return outRange;
+    STimeRangeValue aValue = STimeRangeGetValue(aTimeRange), anotherValue = STimeRangeGetValue(anotherTimeRange);
+    STimeRangeValue outValue = STimeRangeValueUnion(&aValue, &anotherValue);
+    
+    return STimeRangeCreateWithValue(&outValue);
 }
 
 //
@@ -847,46 +1039,10 @@ STimeRangeJoin(
     STimeRangeRef   anotherTimeRange
 )
 {
-    STimeRangeRef   outRange = STimeRangeInvalid;
-
-    if ( STimeRangeIsContiguous(aTimeRange, anotherTimeRange) ) {
-        time_t      start, end;
-        bool        isStartSet = false, isEndSet = false;
-
-        /* find minimum start time */
-        if ( (aTimeRange->options & kSTimeRangeHasLowerBound) && (anotherTimeRange->options & kSTimeRangeHasLowerBound) ) {
-            if ( aTimeRange->start <= anotherTimeRange->start ) {
-                start = aTimeRange->start;
-            } else {
-                start = anotherTimeRange->start;
-            }
-            isStartSet = true;
-        }
-
-        /* find maximum end time */
-        if ( (aTimeRange->options & kSTimeRangeHasUpperBound) && (anotherTimeRange->options & kSTimeRangeHasUpperBound) ) {
-            if ( aTimeRange->end <= anotherTimeRange->end ) {
-                end = anotherTimeRange->end;
-            } else {
-                end = aTimeRange->end;
-            }
-            isEndSet = true;
-        }
-
-        /* create accordingly */
-        if ( isStartSet ) {
-            if ( isEndSet ) {
-                outRange = STimeRangeCreate(start, end);
-            } else {
-                outRange = STimeRangeCreateWithStart(start);
-            }
-        } else if ( isEndSet ) {
-            outRange = STimeRangeCreateWithEnd(end);
-        } else {
-            outRange = STimeRangeInfinite;
-        }
-    }
-    return outRange;
+    STimeRangeValue aValue = STimeRangeGetValue(aTimeRange), anotherValue = STimeRangeGetValue(anotherTimeRange);
+    STimeRangeValue outValue = STimeRangeValueJoin(&aValue, &anotherValue);
+    
+    return STimeRangeCreateWithValue(&outValue);
 }
 
 //
@@ -897,49 +1053,9 @@ STimeRangeCmp(
     STimeRangeRef   rhs
 )
 {
-    if ( (lhs->options & kSTimeRangeIsValid) ) {
-        if ( (rhs->options & kSTimeRangeIsValid) ) {
-            /* both are valid ranges; see which has the earlier start
-             * time
-             */
-            if ( (lhs->options & kSTimeRangeHasLowerBound) ) {
-                if ( (rhs->options & kSTimeRangeHasLowerBound) ) {
-                    if ( lhs->start > rhs->start ) return -1;
-                    if ( lhs->start < rhs->start ) return +1;
-                } else {
-                    /* rhs has no finite start date-time, so lhs is > */
-                    return -1;
-                }
-                /* if we get here, then the start is considered == */
-            } else if ( (rhs->options & kSTimeRangeHasLowerBound) ) {
-                /* lhs has no finite start date-time, so rhs is > */
-                return +1;
-            }
-            /* same start time, now order base on who ends first */
-            if ( (lhs->options & kSTimeRangeHasUpperBound) ) {
-                if ( (rhs->options & kSTimeRangeHasUpperBound) ) {
-                    if ( lhs->end > rhs->end ) return -1;
-                    if ( lhs->end < rhs->end ) return +1;
-                } else {
-                    /* rhs has no finite end date-time, so lhs is < */
-                    return +1;
-                }
-            } else if ( (rhs->options & kSTimeRangeHasUpperBound) ) {
-                /* lhs has no finite end date-time, so rhs is < */
-                return -1;
-            }
-            /* same range */
-            return 0;
-        } else {
-            /* rhs is invalid, sort first */
-            return -1;
-        }
-    } else if ( (rhs->options & kSTimeRangeIsValid) ) {
-        /* lhs is invalid, sort first */
-        return +1;
-    }
-    /* both are invalid */
-    return 0;
+    STimeRangeValue lhsValue = STimeRangeGetValue(lhs), rhsValue = STimeRangeGetValue(rhs);
+    
+    return STimeRangeValueCmp(&lhsValue, &rhsValue);
 }
 
 //
@@ -980,72 +1096,11 @@ STimeRangeCreateByClippingToTimeRange(
     STimeRangeRef   toThis
 )
 {
-    // Default to the invalid range, e.g. if the two don't overlap:
-    STimeRangeRef   outRange = STimeRangeInvalid;
-
-    if ( STimeRangeDoesIntersect(clipThis, toThis) ) {
-        time_t      start, end;
-        bool        isStartSet = false, isEndSet = false;
-        
-        outRange = STimeRangeCopy(clipThis);
-        if ( ! outRange ) return outRange;
-        
-        /* find maximum start time */
-        if ( (outRange->options & kSTimeRangeHasLowerBound) ) {
-            if ( (toThis->options & kSTimeRangeHasLowerBound) ) {
-                if ( outRange->start <= toThis->start ) {
-                    start = toThis->start;
-                } else {
-                    start = outRange->start;
-                }
-                isStartSet = true;
-            } else {
-                start = outRange->start;
-                isStartSet = true;
-            }
-        } else if ( (toThis->options & kSTimeRangeHasLowerBound) ) {
-            start = toThis->start;
-            isStartSet = true;
-        }
-
-        /* find minimum end time */
-        if ( (outRange->options & kSTimeRangeHasUpperBound) ) {
-            if ( (toThis->options & kSTimeRangeHasUpperBound) ) {
-                if ( outRange->end <= toThis->end ) {
-                    end = outRange->end;
-                } else {
-                    end = toThis->end;
-                }
-                isEndSet = true;
-            } else {
-                end = outRange->end;
-                isEndSet = true;
-            }
-        } else if ( (toThis->options & kSTimeRangeHasUpperBound) ) {
-            end = toThis->end;
-            isEndSet = true;
-        }
-
-        /* update accordingly */
-        STimeRange  *CLIPTHIS = (STimeRange*)outRange;
-        
-        if ( isStartSet ) {
-            CLIPTHIS->options |= kSTimeRangeHasLowerBound;
-            CLIPTHIS->start = start;
-        } else {
-            CLIPTHIS->options &= ~kSTimeRangeHasLowerBound;
-            CLIPTHIS->start = 0;
-        }
-        if ( isEndSet ) {
-            CLIPTHIS->options |= kSTimeRangeHasUpperBound;
-            CLIPTHIS->end = end;
-        } else {
-            CLIPTHIS->options &= ~kSTimeRangeHasUpperBound;
-            CLIPTHIS->end = 0;
-        }
-    }
+    STimeRangeValue clipValue = STimeRangeGetValue(clipThis), toValue = STimeRangeGetValue(toThis);
     
-    return outRange;
+    // An invalid range results if the two don't overlap:
+    STimeRangeValueClip(&clipValue, &toValue);
+    return STimeRangeCreateWithValue(&clipValue);
 }
 
 //
@@ -1190,27 +1245,10 @@ STimeRangeGetCountOfPeriodsOfLength(
     time_t          duration
 )
 {
-    if ( ! (aTimeRange->options & kSTimeRangeIsValid) ) return 0;
-    if ( (aTimeRange->options & kSTimeRangeHasLowerBound) ) {
-        //
-        // Do we have an upper bound?
-        //
-        if ( (aTimeRange->options & kSTimeRangeHasUpperBound) ) {
-            uint64_t    dt = (aTimeRange->end - aTimeRange->start + 1);
+    STimeRangeValue aValue = STimeRangeGetValue(aTimeRange);
+    uint64_t        count = STimeRangeValueGetCountOfPeriodsOfLength(&aValue, duration);
 
-            return (dt / duration) + ((dt % duration) ? 1 : 0);
-        }
-        //
-        // Basically an infinite number of indices:
-        //
-        return UINT_MAX;
-    } else {
-        //
-        // Basically an infinite number of indices:
-        //
-        return UINT_MAX;
-    }
-    return 0;
+    return ( count > UINT_MAX ) ? UINT_MAX : (unsigned int)count;
 }
 
 //
@@ -1222,81 +1260,1058 @@ STimeRangeGetPeriodOfLengthAtIndex(
     unsigned int    index
 )
 {
-    time_t          dt = duration * index;
-
-    if ( ! (aTimeRange->options & kSTimeRangeIsValid) ) return NULL;
+    STimeRangeValue aValue = STimeRangeGetValue(aTimeRange), aPeriod;
 
     //
     // If the range is unbounded at the start, then we allocate periods from the end:
     //
-    if ( (aTimeRange->options & kSTimeRangeHasLowerBound) ) {
-        //
-        // Start from lower end:
-        //
-        time_t      start = aTimeRange->start + dt;
+    if ( STimeRangeValueGetPeriodOfLengthAtIndex(&aValue, duration, index, ! (aValue.flags & kSTimeRangeValueHasLowerBound), &aPeriod) ) {
+        return STimeRangeCreateWithValue(&aPeriod);
+    }
+    return NULL;
+}
 
-        //
-        // We have a lower bound, do we have an upper bound?
-        //
-        if ( (aTimeRange->options & kSTimeRangeHasUpperBound) ) {
-            //
-            // Make sure start is below the end time:
-            //
-            if ( start < aTimeRange->end ) {
-                time_t  end = start + duration - 1;
+//
+// By-value time ranges
+//
 
-                if ( end >= aTimeRange->end ) end = aTimeRange->end;
-                return STimeRangeCreate(start, end);
+const STimeRangeValue STimeRangeValueInvalid = { .start = 0, .end = 0, .flags = 0 };
+const STimeRangeValue STimeRangeValueInfinite = { .start = 0, .end = 0, .flags = kSTimeRangeValueIsValid };
+
+//
+
+STimeRangeValue
+STimeRangeValueMake(
+    time_t          start,
+    time_t          end
+)
+{
+    STimeRangeValue newValue = STimeRangeValueInvalid;
+    
+    if ( start <= end ) {
+        newValue.start = start;
+        newValue.end = end;
+        newValue.flags = kSTimeRangeValueIsValid | kSTimeRangeValueHasLowerBound | kSTimeRangeValueHasUpperBound;
+    }
+    return newValue;
+}
+
+STimeRangeValue
+STimeRangeValueMakeWithStart(
+    time_t          start
+)
+{
+    STimeRangeValue newValue = { .start = start, .end = 0, .flags = kSTimeRangeValueIsValid | kSTimeRangeValueHasLowerBound };
+    
+    return newValue;
+}
+
+STimeRangeValue
+STimeRangeValueMakeWithEnd(
+    time_t          end
+)
+{
+    STimeRangeValue newValue = { .start = 0, .end = end, .flags = kSTimeRangeValueIsValid | kSTimeRangeValueHasUpperBound };
+    
+    return newValue;
+}
+
+//
+
+STimeRangeValue
+STimeRangeGetValue(
+    STimeRangeRef   aTimeRange
+)
+{
+    STimeRangeValue outValue = STimeRangeValueInvalid;
+    
+    if ( (aTimeRange->options & kSTimeRangeIsValid) ) {
+        outValue.flags = aTimeRange->options & kSTimeRangeValueMask;
+        if ( (aTimeRange->options & kSTimeRangeHasLowerBound) ) outValue.start = aTimeRange->start;
+        if ( (aTimeRange->options & kSTimeRangeHasUpperBound) ) outValue.end = aTimeRange->end;
+    }
+    return outValue;
+}
+
+STimeRangeRef
+STimeRangeCreateWithValue(
+    const STimeRangeValue   *aValue
+)
+{
+    if ( ! (aValue->flags & kSTimeRangeValueIsValid) ) return STimeRangeInvalid;
+    if ( (aValue->flags & kSTimeRangeValueHasLowerBound) ) {
+        if ( (aValue->flags & kSTimeRangeValueHasUpperBound) ) return STimeRangeCreate(aValue->start, aValue->end);
+        return STimeRangeCreateWithStart(aValue->start);
+    }
+    if ( (aValue->flags & kSTimeRangeValueHasUpperBound) ) return STimeRangeCreateWithEnd(aValue->end);
+    return STimeRangeInfinite;
+}
+
+//
+
+bool
+STimeRangeValueIsValid(
+    const STimeRangeValue   *aValue
+)
+{
+    return ( (aValue->flags & kSTimeRangeValueIsValid) != 0 );
+}
+
+bool
+STimeRangeValueContainsTime(
+    const STimeRangeValue   *aValue,
+    time_t                  theTime
+)
+{
+    if ( ! (aValue->flags & kSTimeRangeValueIsValid) ) return false;
+    if ( (aValue->flags & kSTimeRangeValueHasLowerBound) && (theTime < aValue->start) ) return false;
+    if ( (aValue->flags & kSTimeRangeValueHasUpperBound) && (theTime > aValue->end) ) return false;
+    return true;
+}
+
+bool
+STimeRangeValueIsEqual(
+    const STimeRangeValue   *aValue,
+    const STimeRangeValue   *anotherValue
+)
+{
+    if ( ! (aValue->flags & kSTimeRangeValueIsValid) || (aValue->flags != anotherValue->flags) ) return false;
+    if ( (aValue->flags & kSTimeRangeValueHasLowerBound) && (aValue->start != anotherValue->start) ) return false;
+    if ( (aValue->flags & kSTimeRangeValueHasUpperBound) && (aValue->end != anotherValue->end) ) return false;
+    return true;
+}
+
+bool
+STimeRangeValueDoesIntersect(
+    const STimeRangeValue   *aValue,
+    const STimeRangeValue   *anotherValue
+)
+{
+    if ( ! (aValue->flags & kSTimeRangeValueIsValid) || ! (anotherValue->flags & kSTimeRangeValueIsValid) ) return false;
+    //
+    // Each range must start no later than the other ends (an unbounded start or
+    // end always satisfies that):
+    //
+    if ( (aValue->flags & kSTimeRangeValueHasLowerBound) && (anotherValue->flags & kSTimeRangeValueHasUpperBound) ) {
+        if ( aValue->start > anotherValue->end ) return false;
+    }
+    if ( (anotherValue->flags & kSTimeRangeValueHasLowerBound) && (aValue->flags & kSTimeRangeValueHasUpperBound) ) {
+        if ( anotherValue->start > aValue->end ) return false;
+    }
+    return true;
+}
+
+bool
+STimeRangeValueIsContained(
+    const STimeRangeValue   *aValue,
+    const STimeRangeValue   *inAnotherValue
+)
+{
+    if ( ! (aValue->flags & kSTimeRangeValueIsValid) || ! (inAnotherValue->flags & kSTimeRangeValueIsValid) ) return false;
+    if ( (inAnotherValue->flags & kSTimeRangeValueHasLowerBound) ) {
+        if ( ! (aValue->flags & kSTimeRangeValueHasLowerBound) || (aValue->start < inAnotherValue->start) ) return false;
+    }
+    if ( (inAnotherValue->flags & kSTimeRangeValueHasUpperBound) ) {
+        if ( ! (aValue->flags & kSTimeRangeValueHasUpperBound) || (aValue->end > inAnotherValue->end) ) return false;
+    }
+    return true;
+}
+
+bool
+STimeRangeValueIsContiguous(
+    const STimeRangeValue   *aValue,
+    const STimeRangeValue   *anotherValue
+)
+{
+    if ( (aValue->flags & kSTimeRangeValueIsValid) && (anotherValue->flags & kSTimeRangeValueIsValid) ) {
+        /* the start of one must be the end of the other + 1 */
+        if ( (aValue->flags & kSTimeRangeValueHasUpperBound) && (anotherValue->flags & kSTimeRangeValueHasLowerBound) ) {
+            if ( aValue->end + 1 == anotherValue->start ) return true;
+        }
+        if ( (aValue->flags & kSTimeRangeValueHasLowerBound) && (anotherValue->flags & kSTimeRangeValueHasUpperBound) ) {
+            if ( anotherValue->end + 1 == aValue->start ) return true;
+        }
+    }
+    return false;
+}
+
+//
+
+int
+STimeRangeValueCmp(
+    const STimeRangeValue   *lhs,
+    const STimeRangeValue   *rhs
+)
+{
+    if ( (lhs->flags & kSTimeRangeValueIsValid) ) {
+        if ( ! (rhs->flags & kSTimeRangeValueIsValid) ) {
+            /* rhs is invalid, sort first */
+            return -1;
+        }
+        /* both are valid ranges; see which has the earlier start time */
+        if ( (lhs->flags & kSTimeRangeValueHasLowerBound) ) {
+            if ( ! (rhs->flags & kSTimeRangeValueHasLowerBound) ) return -1;
+            if ( lhs->start > rhs->start ) return -1;
+            if ( lhs->start < rhs->start ) return +1;
+        } else if ( (rhs->flags & kSTimeRangeValueHasLowerBound) ) {
+            return +1;
+        }
+        /* same start time, now order base on who ends first */
+        if ( (lhs->flags & kSTimeRangeValueHasUpperBound) ) {
+            if ( ! (rhs->flags & kSTimeRangeValueHasUpperBound) ) return +1;
+            if ( lhs->end > rhs->end ) return -1;
+            if ( lhs->end < rhs->end ) return +1;
+        } else if ( (rhs->flags & kSTimeRangeValueHasUpperBound) ) {
+            return -1;
+        }
+        return 0;
+    }
+    /* lhs is invalid, sort first unless rhs is invalid, too */
+    return ( (rhs->flags & kSTimeRangeValueIsValid) ? +1 : 0 );
+}
+
+//
+
+STimeRangeValue
+STimeRangeValueIntersection(
+    const STimeRangeValue   *aValue,
+    const STimeRangeValue   *anotherValue
+)
+{
+    STimeRangeValue         outValue = *aValue;
+    
+    STimeRangeValueClip(&outValue, anotherValue);
+    return outValue;
+}
+
+//
+
+STimeRangeValue
+__STimeRangeValueCover(
+    const STimeRangeValue   *aValue,
+    const STimeRangeValue   *anotherValue
+)
+{
+    STimeRangeValue         outValue = STimeRangeValueInfinite;
+    
+    /* find minimum start time */
+    if ( (aValue->flags & kSTimeRangeValueHasLowerBound) && (anotherValue->flags & kSTimeRangeValueHasLowerBound) ) {
+        outValue.start = ( aValue->start <= anotherValue->start ) ? aValue->start : anotherValue->start;
+        outValue.flags |= kSTimeRangeValueHasLowerBound;
+    }
+    /* find maximum end time */
+    if ( (aValue->flags & kSTimeRangeValueHasUpperBound) && (anotherValue->flags & kSTimeRangeValueHasUpperBound) ) {
+        outValue.end = ( aValue->end >= anotherValue->end ) ? aValue->end : anotherValue->end;
+        outValue.flags |= kSTimeRangeValueHasUpperBound;
+    }
+    return outValue;
+}
+
+STimeRangeValue
+STimeRangeValueUnion(
+    const STimeRangeValue   *aValue,
+    const STimeRangeValue   *anotherValue
+)
+{
+    if ( ! STimeRangeValueDoesIntersect(aValue, anotherValue) ) return STimeRangeValueInvalid;
+    return __STimeRangeValueCover(aValue, anotherValue);
+}
+
+STimeRangeValue
+STimeRangeValueJoin(
+    const STimeRangeValue   *aValue,
+    const STimeRangeValue   *anotherValue
+)
+{
+    if ( ! STimeRangeValueIsContiguous(aValue, anotherValue) ) return STimeRangeValueInvalid;
+    return __STimeRangeValueCover(aValue, anotherValue);
+}
+
+//
+
+bool
+STimeRangeValueClip(
+    STimeRangeValue         *clipThis,
+    const STimeRangeValue   *toThis
+)
+{
+    if ( ! STimeRangeValueDoesIntersect(clipThis, toThis) ) {
+        *clipThis = STimeRangeValueInvalid;
+        return false;
+    }
+    /* find maximum start time */
+    if ( (toThis->flags & kSTimeRangeValueHasLowerBound) ) {
+        if ( ! (clipThis->flags & kSTimeRangeValueHasLowerBound) || (clipThis->start < toThis->start) ) {
+            clipThis->start = toThis->start;
+            clipThis->flags |= kSTimeRangeValueHasLowerBound;
+        }
+    }
+    /* find minimum end time */
+    if ( (toThis->flags & kSTimeRangeValueHasUpperBound) ) {
+        if ( ! (clipThis->flags & kSTimeRangeValueHasUpperBound) || (clipThis->end > toThis->end) ) {
+            clipThis->end = toThis->end;
+            clipThis->flags |= kSTimeRangeValueHasUpperBound;
+        }
+    }
+    return true;
+}
+
+//
+
+bool
+STimeRangeValueSplitAtTime(
+    const STimeRangeValue   *aValue,
+    time_t                  splitTime,
+    STimeRangeValue         *outLeading,
+    STimeRangeValue         *outTrailing
+)
+{
+    STimeRangeValue         leading = STimeRangeValueInvalid, trailing = STimeRangeValueInvalid;
+    
+    if ( (aValue->flags & kSTimeRangeValueIsValid) ) {
+        if ( ! (aValue->flags & kSTimeRangeValueHasLowerBound) || (aValue->start < splitTime) ) {
+            leading = *aValue;
+            if ( ! (leading.flags & kSTimeRangeValueHasUpperBound) || (leading.end >= splitTime) ) {
+                leading.end = splitTime - 1;
+                leading.flags |= kSTimeRangeValueHasUpperBound;
             }
-        } else {
-            //
-            // No upper bound:
-            //
-            return STimeRangeCreate(start, start + duration - 1);
         }
+        if ( ! (aValue->flags & kSTimeRangeValueHasUpperBound) || (splitTime <= aValue->end) ) {
+            trailing = *aValue;
+            if ( ! (trailing.flags & kSTimeRangeValueHasLowerBound) || (trailing.start < splitTime) ) {
+                trailing.start = splitTime;
+                trailing.flags |= kSTimeRangeValueHasLowerBound;
+            }
+        }
+    }
+    if ( outLeading ) *outLeading = leading;
+    if ( outTrailing ) *outTrailing = trailing;
+    return ( (leading.flags & kSTimeRangeValueIsValid) && (trailing.flags & kSTimeRangeValueIsValid) );
+}
+
+//
+// Periods of fixed length are counted in 64 bits:  a range without the bound
+// the pieces are measured from reaches to the limit of time_t, so every offset
+// and span below is computed as an unsigned difference that cannot overflow.
+//
+
+#define STIMERANGE_TIME_MAX     ((time_t)(((uint64_t)1 << (8 * sizeof(time_t) - 1)) - 1))
+#define STIMERANGE_TIME_MIN     (-STIMERANGE_TIME_MAX - 1)
+
+uint64_t
+STimeRangeValueGetCountOfPeriodsOfLength(
+    const STimeRangeValue   *aValue,
+    time_t                  duration
+)
+{
+    uint64_t                count;
+
+    if ( ! (aValue->flags & kSTimeRangeValueIsValid) || (duration <= 0) ) return 0;
+    if ( (aValue->flags & kSTimeRangeBoundsMask) != kSTimeRangeBoundsMask ) return UINT64_MAX;
+    count = ((uint64_t)aValue->end - (uint64_t)aValue->start) / (uint64_t)duration;
+    return ( count < UINT64_MAX ) ? count + 1 : UINT64_MAX;
+}
+
+//
+
+bool
+STimeRangeValueGetPeriodOfLengthAtIndex(
+    const STimeRangeValue   *aValue,
+    time_t                  duration,
+    uint64_t                index,
+    bool                    fromEnd,
+    STimeRangeValue         *outPeriod
+)
+{
+    uint64_t                span, offset;
+
+    if ( ! (aValue->flags & kSTimeRangeValueIsValid) || (duration <= 0) ) return false;
+    if ( fromEnd ) {
+        time_t              limit = (aValue->flags & kSTimeRangeValueHasLowerBound) ? aValue->start : STIMERANGE_TIME_MIN;
+        time_t              end;
+
+        if ( ! (aValue->flags & kSTimeRangeValueHasUpperBound) ) return false;
+        span = (uint64_t)aValue->end - (uint64_t)limit;
+        if ( index > span / (uint64_t)duration ) return false;
+        offset = index * (uint64_t)duration;
+        end = (time_t)((uint64_t)aValue->end - offset);
+        *outPeriod = STimeRangeValueMake(( span - offset < (uint64_t)duration ) ? limit : end - duration + 1, end);
+    } else {
+        time_t              limit = (aValue->flags & kSTimeRangeValueHasUpperBound) ? aValue->end : STIMERANGE_TIME_MAX;
+        time_t              start;
+
+        if ( ! (aValue->flags & kSTimeRangeValueHasLowerBound) ) return false;
+        span = (uint64_t)limit - (uint64_t)aValue->start;
+        if ( index > span / (uint64_t)duration ) return false;
+        offset = index * (uint64_t)duration;
+        start = (time_t)((uint64_t)aValue->start + offset);
+        *outPeriod = STimeRangeValueMake(start, ( span - offset < (uint64_t)duration ) ? limit : start + duration - 1);
+    }
+    return true;
+}
+
+//
+
+bool
+STimeRangePeriodGeneratorInit(
+    STimeRangePeriodGenerator   *aGenerator,
+    const STimeRangeValue       *aValue,
+    time_t                      duration,
+    bool                        isReverse
+)
+{
+    STimeRangeValue             firstPeriod;
+
+    aGenerator->range = *aValue;
+    aGenerator->duration = duration;
+    aGenerator->nextIndex = 0;
+    aGenerator->isReverse = isReverse;
+    if ( ! STimeRangeValueGetPeriodOfLengthAtIndex(aValue, duration, 0, isReverse, &firstPeriod) ) {
+        aGenerator->range = STimeRangeValueInvalid;
+        return false;
+    }
+    return true;
+}
+
+//
+
+bool
+STimeRangePeriodGeneratorNext(
+    STimeRangePeriodGenerator   *aGenerator,
+    STimeRangeValue             *outPeriod
+)
+{
+    if ( ! STimeRangeValueGetPeriodOfLengthAtIndex(&aGenerator->range, aGenerator->duration, aGenerator->nextIndex, aGenerator->isReverse, outPeriod) ) return false;
+    aGenerator->nextIndex++;
+    return true;
+}
+
+//
+
+char*
+__STimeRangeFormatDigits(
+    char            *buffer,
+    unsigned int    nDigits,
+    unsigned int    value
+)
+{
+    char            *p = buffer + nDigits;
+    
+    while ( p > buffer ) {
+        *(--p) = '0' + (value % 10);
+        value /= 10;
+    }
+    return buffer + nDigits;
+}
+
+#define STIMERANGE_DATETIME_LENGTH          20
+
+size_t
+__STimeRangeFormatDateTime(
+    time_t          theTime,
+    char            *buffer,
+    size_t          bufferSize
+)
+{
+    //
+    // Equivalent to strftime() with __STimeRangeDateTimeFormat, but the digits
+    // are written directly from the cached civil time conversion:
+    //
+    STimeZoneCivilTime  civilTime;
+    
+    if ( (bufferSize > STIMERANGE_DATETIME_LENGTH) && STimeZoneTimeToCivil(theTime, &civilTime) && (civilTime.year >= 1000) && (civilTime.year <= 9999) ) {
+        char            *p = buffer;
+        long            absOffset = ( civilTime.utcOffset < 0 ) ? -civilTime.utcOffset : civilTime.utcOffset;
+        
+        p = __STimeRangeFormatDigits(p, 4, (unsigned int)civilTime.year);
+        p = __STimeRangeFormatDigits(p, 2, civilTime.month);
+        p = __STimeRangeFormatDigits(p, 2, civilTime.day);
+        *p++ = 'T';
+        p = __STimeRangeFormatDigits(p, 2, civilTime.hour);
+        p = __STimeRangeFormatDigits(p, 2, civilTime.minute);
+        p = __STimeRangeFormatDigits(p, 2, civilTime.second);
+        *p++ = ( civilTime.utcOffset < 0 ) ? '-' : '+';
+        p = __STimeRangeFormatDigits(p, 2, (unsigned int)(absOffset / 3600));
+        p = __STimeRangeFormatDigits(p, 2, (unsigned int)((absOffset / 60) % 60));
+        *p = '\0';
+        return STIMERANGE_DATETIME_LENGTH;
+    }
+    
+    //
+    // Years outside 1000-9999 aren't fixed-width, so leave them to strftime():
+    //
+    struct tm       unparsed_time;
+    
+    if ( ! localtime_r(&theTime, &unparsed_time) ) return 0;
+    return strftime(buffer, bufferSize, __STimeRangeDateTimeFormat, &unparsed_time);
+}
+
+//
+
+bool
+STimeRangeValueParse(
+    const char      *timeRangeStr,
+    STimeRangeValue *outValue,
+    const char*     *outEndPtr
+)
+{
+    time_t          start = 0, end = 0;
+    bool            isStartSet = false, isEndSet = false;
+
+    *outValue = STimeRangeValueInvalid;
+    while ( isspace(*timeRangeStr) ) timeRangeStr++;
+
+    if ( *timeRangeStr != ':' ) {
+        /*
+         * the string doesn't lead with a colon, so it has a start date-time
+         */
+        if ( ! (timeRangeStr = __STimeRangeParseRangeDateTime(timeRangeStr, &start)) ) return false;
+        isStartSet = true;
+    }
+    if ( *timeRangeStr == ':' ) {
+        /*
+         * there's a colon, so check for a trailing end date-time
+         */
+        if ( *(++timeRangeStr) ) {
+            if ( ! (timeRangeStr = __STimeRangeParseRangeDateTime(timeRangeStr, &end)) ) return false;
+            isEndSet = true;
+        }
+    }
+    if ( outEndPtr) *outEndPtr = timeRangeStr;
+    if ( isStartSet ) {
+        *outValue = isEndSet ? STimeRangeValueMake(start, end) : STimeRangeValueMakeWithStart(start);
     } else {
+        *outValue = isEndSet ? STimeRangeValueMakeWithEnd(end) : STimeRangeValueInfinite;
+    }
+    return ( (outValue->flags & kSTimeRangeValueIsValid) != 0 );
+}
+
+//
+
+bool
+STimeRangeValueParseWithLength(
+    const char      *timeRangeStr,
+    size_t          timeRangeLen,
+    STimeRangeValue *outValue,
+    const char*     *outEndPtr
+)
+{
+    if ( (timeRangeLen == STIMERANGE_CANONICAL_RANGE_LEN) && __STimeRangeDecodeCanonicalRange(timeRangeStr, outValue) ) {
+        if ( outEndPtr ) *outEndPtr = timeRangeStr + STIMERANGE_CANONICAL_RANGE_LEN;
+        return ( (outValue->flags & kSTimeRangeValueIsValid) != 0 );
+    }
+    return STimeRangeValueParse(timeRangeStr, outValue, outEndPtr);
+}
+
+//
+
+#ifndef STIMERANGE_PARSE_LINE_MAX
+#define STIMERANGE_PARSE_LINE_MAX   128
+#endif
+
+bool
+STimeRangeParseBuffer(
+    const char      *buffer,
+    size_t          bufferLen,
+    STimeRangeValue *outValues,
+    size_t          *ioValueCount,
+    size_t          *outErrorLine
+)
+{
+    const char      *bufferEnd = buffer + bufferLen;
+    size_t          valueCapacity = *ioValueCount, valueCount = 0, lineNumber = 0;
+    char            line[STIMERANGE_PARSE_LINE_MAX];
+
+    while ( buffer < bufferEnd ) {
+        const char  *lineEnd = memchr(buffer, '\n', bufferEnd - buffer);
+        const char  *nextLine, *endptr;
+        size_t      lineLen;
+
+        if ( lineEnd ) {
+            nextLine = lineEnd + 1;
+        } else {
+            nextLine = lineEnd = bufferEnd;
+        }
+        lineNumber++;
+
         //
-        // No lower bound, do we have an upper bound?
+        // Trim the line; blank lines are skipped:
         //
-        if ( (aTimeRange->options & kSTimeRangeHasUpperBound) ) {
+        while ( (buffer < lineEnd) && isspace((unsigned char)*buffer) ) buffer++;
+        while ( (lineEnd > buffer) && isspace((unsigned char)*(lineEnd - 1)) ) lineEnd--;
+        if ( (lineLen = lineEnd - buffer) > 0 ) {
             //
-            // Start from upper end:
+            // The parsers expect a NUL-terminated string, and the buffer need not
+            // have one; no valid range comes close to filling the scratch copy:
             //
-            return STimeRangeCreate(aTimeRange->end - dt - duration + 1, aTimeRange->end - dt);
+            if ( (valueCount == valueCapacity) || (lineLen >= sizeof(line)) ) goto error;
+            memcpy(line, buffer, lineLen);
+            line[lineLen] = '\0';
+            if ( ! STimeRangeValueParseWithLength(line, lineLen, &outValues[valueCount], &endptr) || *endptr ) goto error;
+            valueCount++;
         }
+        buffer = nextLine;
     }
-    return NULL;
+    *ioValueCount = valueCount;
+    if ( outErrorLine ) *outErrorLine = 0;
+    return true;
+
+error:
+    *ioValueCount = valueCount;
+    if ( outErrorLine ) *outErrorLine = lineNumber;
+    return false;
+}
+
+//
+
+size_t
+STimeRangeValueFormat(
+    const STimeRangeValue   *aValue,
+    char                    *buffer,
+    size_t                  bufferSize
+)
+{
+    size_t                  len = 0, n;
+    
+    if ( bufferSize == 0 ) return 0;
+    buffer[0] = '\0';
+    if ( ! (aValue->flags & kSTimeRangeValueIsValid) || ! (aValue->flags & kSTimeRangeBoundsMask) ) {
+        /* same text as the shared invalid and infinite time ranges */
+        const char          *fixedStr = (aValue->flags & kSTimeRangeValueIsValid) ? __STimeRangeInfinite.cstr : __STimeRangeInvalid.cstr;
+        
+        if ( (len = strlen(fixedStr)) >= bufferSize ) return 0;
+        memcpy(buffer, fixedStr, len + 1);
+        return len;
+    }
+    if ( (aValue->flags & kSTimeRangeValueHasLowerBound) ) {
+        if ( ! (len = __STimeRangeFormatDateTime(aValue->start, buffer, bufferSize)) ) goto overflow;
+    }
+    if ( len + 1 >= bufferSize ) goto overflow;
+    buffer[len++] = ':';
+    buffer[len] = '\0';
+    if ( (aValue->flags & kSTimeRangeValueHasUpperBound) ) {
+        if ( ! (n = __STimeRangeFormatDateTime(aValue->end, buffer + len, bufferSize - len)) ) goto overflow;
+        len += n;
+    }
+    return len;
+
+overflow:
+    buffer[0] = '\0';
+    return 0;
+}
+
+//
+
+size_t
+__STimeRangeFormatEpochDateTime(
+    time_t          theTime,
+    char            *buffer,
+    size_t          bufferSize
+)
+{
+    char            digits[20];
+    uint64_t        value = ( theTime < 0 ) ? (0 - (uint64_t)theTime) : (uint64_t)theTime;
+    size_t          nDigits = 0, len;
+    
+    do {
+        digits[nDigits++] = '0' + (value % 10);
+        value /= 10;
+    } while ( value );
+    len = 1 + ( theTime < 0 ) + nDigits;
+    if ( len >= bufferSize ) return 0;
+    *buffer++ = '@';
+    if ( theTime < 0 ) *buffer++ = '-';
+    while ( nDigits ) *buffer++ = digits[--nDigits];
+    *buffer = '\0';
+    return len;
+}
+
+size_t
+STimeRangeValueFormatEpoch(
+    const STimeRangeValue   *aValue,
+    char                    *buffer,
+    size_t                  bufferSize
+)
+{
+    size_t                  len = 0, n;
+    
+    if ( bufferSize == 0 ) return 0;
+    buffer[0] = '\0';
+    if ( ! (aValue->flags & kSTimeRangeValueIsValid) ) {
+        if ( (len = strlen(__STimeRangeInvalid.cstr)) >= bufferSize ) return 0;
+        memcpy(buffer, __STimeRangeInvalid.cstr, len + 1);
+        return len;
+    }
+    if ( (aValue->flags & kSTimeRangeValueHasLowerBound) ) {
+        if ( ! (len = __STimeRangeFormatEpochDateTime(aValue->start, buffer, bufferSize)) ) goto overflow;
+    }
+    if ( len + 1 >= bufferSize ) goto overflow;
+    buffer[len++] = ':';
+    buffer[len] = '\0';
+    if ( (aValue->flags & kSTimeRangeValueHasUpperBound) ) {
+        if ( ! (n = __STimeRangeFormatEpochDateTime(aValue->end, buffer + len, bufferSize - len)) ) goto overflow;
+        len += n;
+    }
+    return len;
+
+overflow:
+    buffer[0] = '\0';
+    return 0;
 }
 
 //
 
 #ifdef STIMERANGE_UNIT_TEST
 
+#ifndef STIMERANGE_UNIT_TEST_DECODE_COUNT
+#define STIMERANGE_UNIT_TEST_DECODE_COUNT 2000000
+#endif
+
+void
+__STimeRangeUnitTestMakeCanonicalRange(
+    char            *rangeStr
+)
+{
+    //
+    // Two YYYYMMDDTHHMMSS±HHMM date-times with every field in range, joined by
+    // a colon:
+    //
+    int             i;
+    
+    for ( i = 0; i < 2; i++ ) {
+        char            dateTimeStr[32];
+        
+        snprintf(dateTimeStr, sizeof(dateTimeStr), "%04d%02d%02dT%02d%02d%02d%c%02d%02d",
+                    (int)(random() % 10000), (int)(1 + random() % 12), (int)(1 + random() % 31),
+                    (int)(random() % 24), (int)(random() % 60), (int)(random() % 61),
+                    ( random() % 2 ) ? '+' : '-', (int)(random() % 24), (int)(random() % 60));
+        memcpy(rangeStr + 21 * i, dateTimeStr, 20);
+    }
+    rangeStr[20] = ':';
+}
+
+void
+__STimeRangeUnitTestMutateCanonicalRange(
+    char            *rangeStr
+)
+{
+    //
+    // Fields the decoders range check, as (offset, bad values); the end
+    // date-time's fields are 21 bytes further along:
+    //
+    static const struct {
+        int         offset;
+        const char  *badValues[4];
+    } badFields[] = {
+            { 4, { "00", "13", "99", NULL } },         // month
+            { 6, { "00", "32", "99", NULL } },         // day
+            { 9, { "24", "99", NULL } },               // hour
+            { 11, { "60", "99", NULL } },              // minute
+            { 13, { "61", "99", NULL } },              // second
+            { 16, { "24", "99", NULL } },              // offset hours
+            { 18, { "60", "99", NULL } }               // offset minutes
+        };
+    static const char digitPositions[] = { 0, 1, 2, 3, 4, 5, 6, 7, 9, 10, 11, 12, 13, 14, 16, 17, 18, 19 };
+    static const char literalPositions[] = { 8, 15, 20, 29, 36 };
+    static const char notDigits[] = { '/', ':', ' ', 'O', 'o', '\xB0', '\x10', '\x80' };
+    int             which;
+    
+    switch ( random() % 6 ) {
+        case 0:
+            // Left valid:
+            break;
+        case 1:
+            // Any byte anywhere:
+            rangeStr[random() % STIMERANGE_CANONICAL_RANGE_LEN] = (char)(random() % 256);
+            break;
+        case 2:
+            // A digit that's not a digit (the ASCII neighbours of '0'..'9' in particular):
+            rangeStr[digitPositions[random() % sizeof(digitPositions)] + 21 * (random() % 2)] = notDigits[random() % sizeof(notDigits)];
+            break;
+        case 3: {
+            // A field out of range:
+            const char  *badValue;
+            
+            which = random() % (sizeof(badFields) / sizeof(badFields[0]));
+            do {
+                badValue = badFields[which].badValues[random() % 4];
+            } while ( ! badValue );
+            memcpy(rangeStr + badFields[which].offset + 21 * (random() % 2), badValue, 2);
+            break;
+        }
+        case 4:
+            // A literal that's wrong:
+            which = literalPositions[random() % sizeof(literalPositions)];
+            rangeStr[which] = ( random() % 2 ) ? rangeStr[which] ^ 0x20 : (char)('0' + random() % 10);
+            break;
+        case 5:
+            // A ±HH offset in place of ±HHMM (the range is no longer fixed-width):
+            which = ( random() % 2 ) ? 18 : 39;
+            memmove(rangeStr + which, rangeStr + which + 2, STIMERANGE_CANONICAL_RANGE_LEN + 1 - (which + 2));
+            break;
+    }
+}
+
+int
+__STimeRangeUnitTestCanonicalDecoders(
+    unsigned long   count
+)
+{
+    //
+    // Every vector kernel this CPU can run must agree exactly with the scalar
+    // (canonical) decoder on whether each string is accepted and, if it is, on
+    // the decoded range:
+    //
+    __STimeRangeCanonicalRangeDecoder   decoders[2];
+    const char                          *decoderNames[2];
+    unsigned int                        decoderCount = 0, j;
+    unsigned long                       i, accepted = 0, failures = 0;
+    
+#ifdef STIMERANGE_HAVE_X86_SIMD
+    __builtin_cpu_init();
+    if ( __builtin_cpu_supports("sse4.1") ) {
+        decoderNames[decoderCount] = "SSE4.1";
+        decoders[decoderCount++] = __STimeRangeDecodeCanonicalRangeSSE41;
+    }
+    if ( __builtin_cpu_supports("avx2") ) {
+        decoderNames[decoderCount] = "AVX2";
+        decoders[decoderCount++] = __STimeRangeDecodeCanonicalRangeAVX2;
+    }
+#endif
+    if ( decoderCount == 0 ) {
+        printf("canonical decoders: no vector kernels to check\n");
+        return 0;
+    }
+    
+    srandom(1);
+    for ( i = 0; i < count; i++ ) {
+        char            rangeStr[64] = { 0 };
+        STimeRangeValue scalarValue, value;
+        bool            isScalarOk;
+        
+        __STimeRangeUnitTestMakeCanonicalRange(rangeStr);
+        __STimeRangeUnitTestMutateCanonicalRange(rangeStr);
+        if ( (isScalarOk = __STimeRangeDecodeCanonicalRangeScalar(rangeStr, &scalarValue)) ) accepted++;
+        for ( j = 0; j < decoderCount; j++ ) {
+            bool        isOk = decoders[j](rangeStr, &value);
+            
+            //
+            // (Compared field by field:  a start after the end decodes to the
+            // invalid value, which STimeRangeValueIsEqual() matches to nothing.)
+            //
+            if ( (isOk != isScalarOk) || (isOk && ((value.flags != scalarValue.flags) || (value.start != scalarValue.start) || (value.end != scalarValue.end))) ) {
+                if ( failures++ < 10 ) printf("canonical decoders: %s disagrees with scalar on \"%.41s\"\n", decoderNames[j], rangeStr);
+            }
+        }
+    }
+    printf("canonical decoders: %lu strings (%lu valid), %lu disagreements\n", count, accepted, failures);
+    return ( failures == 0 ) ? 0 : 1;
+}
+
+//
+
+#ifndef STIMERANGE_UNIT_TEST_BENCHMARK_COUNT
+#define STIMERANGE_UNIT_TEST_BENCHMARK_COUNT 20000000
+#endif
+
+double
+__STimeRangeUnitTestNanoseconds(void)
+{
+    struct timespec     now;
+    
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return 1e9 * now.tv_sec + now.tv_nsec;
+}
+
 int
-main()
+__STimeRangeUnitTestBenchmark(
+    unsigned long       count
+)
+{
+    //
+    // Single-threaded cost of reference counting and string formatting; build
+    // with DTRMGR_ENABLE_ATOMIC_REFCOUNT on and off to compare:
+    //
+    STimeRangeRef       aTimeRange = STimeRangeCreate(0, 86399);
+    STimeRangeRef       volatile sink;
+    unsigned long       i;
+    double              t0;
+    
+    if ( ! aTimeRange ) return ENOMEM;
+#ifdef DTRMGR_ENABLE_ATOMIC_REFCOUNT
+    printf("reference counts: atomic\n");
+#else
+    printf("reference counts: plain\n");
+#endif
+
+    t0 = __STimeRangeUnitTestNanoseconds();
+    for ( i = 0; i < count; i++ ) {
+        sink = STimeRangeRetain(aTimeRange);
+        STimeRangeRelease(sink);
+    }
+    printf("  retain+release pair      %6.2f ns\n", (__STimeRangeUnitTestNanoseconds() - t0) / count);
+    
+    t0 = __STimeRangeUnitTestNanoseconds();
+    for ( i = 0; i < count; i++ ) {
+        sink = STimeRangeCreate(i, i + 3599);
+        STimeRangeRelease(sink);
+    }
+    printf("  create+release           %6.2f ns\n", (__STimeRangeUnitTestNanoseconds() - t0) / count);
+    
+    t0 = __STimeRangeUnitTestNanoseconds();
+    for ( i = 0; i < count / 10; i++ ) {
+        sink = STimeRangeCreate(i, i + 3599);
+        STimeRangeGetCString(sink);
+        STimeRangeRelease(sink);
+    }
+    printf("  create+format+release    %6.2f ns\n", (__STimeRangeUnitTestNanoseconds() - t0) / (count / 10));
+    
+    t0 = __STimeRangeUnitTestNanoseconds();
+    for ( i = 0; i < count; i++ ) sink = (STimeRangeRef)STimeRangeGetCString(aTimeRange);
+    printf("  formatted string lookup  %6.2f ns\n", (__STimeRangeUnitTestNanoseconds() - t0) / count);
+    
+    STimeRangeRelease(aTimeRange);
+    return 0;
+}
+
+//
+
+#ifndef STIMERANGE_UNIT_TEST_THREAD_COUNT
+#define STIMERANGE_UNIT_TEST_THREAD_COUNT 8
+#endif
+#ifndef STIMERANGE_UNIT_TEST_THREAD_ROUNDS
+#define STIMERANGE_UNIT_TEST_THREAD_ROUNDS 2000
+#endif
+#ifndef STIMERANGE_UNIT_TEST_THREAD_RANGES
+#define STIMERANGE_UNIT_TEST_THREAD_RANGES 64
+#endif
+
+//
+// Each round the main thread creates a batch of ranges that all the worker
+// threads then retain, format (every thread racing for the first request of
+// each string), and release at once.  Workers also hand ranges they created to
+// one another, so objects are released on threads other than their creator's.
+// Run under ThreadSanitizer to check for races.
+//
+static pthread_barrier_t __STimeRangeUnitTestBarrier;
+static STimeRangeRef __STimeRangeUnitTestShared[STIMERANGE_UNIT_TEST_THREAD_RANGES];
+static STimeRangeRef __STimeRangeUnitTestHandoff[STIMERANGE_UNIT_TEST_THREAD_RANGES];
+static pthread_mutex_t __STimeRangeUnitTestHandoffLock = PTHREAD_MUTEX_INITIALIZER;
+
+void*
+__STimeRangeUnitTestThread(
+    void                *context
+)
+{
+    unsigned long       threadIndex = (unsigned long)context, failures = 0;
+    unsigned int        round, i;
+    
+    for ( round = 0; round < STIMERANGE_UNIT_TEST_THREAD_ROUNDS; round++ ) {
+        pthread_barrier_wait(&__STimeRangeUnitTestBarrier);
+        for ( i = 0; i < STIMERANGE_UNIT_TEST_THREAD_RANGES; i++ ) {
+            unsigned int    index = (i + 7 * threadIndex) % STIMERANGE_UNIT_TEST_THREAD_RANGES;
+            STimeRangeRef   aTimeRange = STimeRangeRetain(__STimeRangeUnitTestShared[index]);
+            STimeRangeRef   handoff = STimeRangeCreate(round, round + i + 1);
+            STimeRangeValue aValue = STimeRangeGetValue(aTimeRange);
+            char            expected[STIMERANGE_CSTRING_MAX];
+            
+            STimeRangeValueFormat(&aValue, expected, sizeof(expected));
+            if ( strcmp(STimeRangeGetCString(aTimeRange), expected) != 0 ) failures++;
+            STimeRangeRelease(aTimeRange);
+            
+            pthread_mutex_lock(&__STimeRangeUnitTestHandoffLock);
+            aTimeRange = __STimeRangeUnitTestHandoff[index];
+            __STimeRangeUnitTestHandoff[index] = handoff;
+            pthread_mutex_unlock(&__STimeRangeUnitTestHandoffLock);
+            if ( aTimeRange ) STimeRangeRelease(aTimeRange);
+        }
+        pthread_barrier_wait(&__STimeRangeUnitTestBarrier);
+    }
+    return (void*)failures;
+}
+
+int
+__STimeRangeUnitTestThreads(void)
+{
+    pthread_t           threads[STIMERANGE_UNIT_TEST_THREAD_COUNT];
+    unsigned long       failures = 0;
+    unsigned int        round, i;
+    
+    pthread_barrier_init(&__STimeRangeUnitTestBarrier, NULL, STIMERANGE_UNIT_TEST_THREAD_COUNT + 1);
+    for ( i = 0; i < STIMERANGE_UNIT_TEST_THREAD_COUNT; i++ ) {
+        if ( pthread_create(&threads[i], NULL, __STimeRangeUnitTestThread, (void*)(unsigned long)i) != 0 ) return errno;
+    }
+    for ( round = 0; round < STIMERANGE_UNIT_TEST_THREAD_ROUNDS; round++ ) {
+        for ( i = 0; i < STIMERANGE_UNIT_TEST_THREAD_RANGES; i++ ) {
+            __STimeRangeUnitTestShared[i] = STimeRangeCreate(1000000 * round + 3600 * i, 1000000 * round + 3600 * (i + 1) - 1);
+        }
+        pthread_barrier_wait(&__STimeRangeUnitTestBarrier);
+        pthread_barrier_wait(&__STimeRangeUnitTestBarrier);
+        
+        //
+        // Every worker's retains have been matched by releases:
+        //
+        for ( i = 0; i < STIMERANGE_UNIT_TEST_THREAD_RANGES; i++ ) {
+            if ( SREFCOUNT_GET(((STimeRange*)__STimeRangeUnitTestShared[i])->refcount) != 1 ) failures++;
+            STimeRangeRelease(__STimeRangeUnitTestShared[i]);
+        }
+    }
+    for ( i = 0; i < STIMERANGE_UNIT_TEST_THREAD_COUNT; i++ ) {
+        void            *threadFailures;
+        
+        pthread_join(threads[i], &threadFailures);
+        failures += (unsigned long)threadFailures;
+    }
+    for ( i = 0; i < STIMERANGE_UNIT_TEST_THREAD_RANGES; i++ ) {
+        if ( __STimeRangeUnitTestHandoff[i] ) STimeRangeRelease(__STimeRangeUnitTestHandoff[i]);
+    }
+    pthread_barrier_destroy(&__STimeRangeUnitTestBarrier);
+    printf("threads: %d threads x %d rounds x %d shared ranges, %lu failures\n",
+            STIMERANGE_UNIT_TEST_THREAD_COUNT, STIMERANGE_UNIT_TEST_THREAD_ROUNDS, STIMERANGE_UNIT_TEST_THREAD_RANGES, failures);
+    return ( failures == 0 ) ? 0 : 1;
+}
+
+//
+
+int
+main(
+    int             argc,
+    char            *argv[]
+)
 {
     STimeRangeRef   t1, t2, t3, t4, t5, t6, t7, r1, r2, r3, r4;
     time_t          t = time(NULL), tprime;
 
+    //
+    // "bench" and "threads" run just the benchmark or the thread test:
+    //
+    if ( argc > 1 ) {
+        if ( strcmp(argv[1], "bench") == 0 ) return __STimeRangeUnitTestBenchmark(STIMERANGE_UNIT_TEST_BENCHMARK_COUNT);
+        if ( strcmp(argv[1], "threads") == 0 ) return __STimeRangeUnitTestThreads();
+        fprintf(stderr, "usage: %s {bench|threads}\n", argv[0]);
+        return EINVAL;
+    }
+    if ( __STimeRangeUnitTestCanonicalDecoders(STIMERANGE_UNIT_TEST_DECODE_COUNT) ) return 1;
+
     printf("Origin %s\n", ctime(&t));
 
     tprime = STimeRangeJustifyTime(t, kSTimeRangeJustifyTimeToMinutes, false);
-    printf("%lld %lld = %s\n", t, tprime, ctime(&tprime));
+    printf("%lld %lld = %s\n", (long long)t, (long long)tprime, ctime(&tprime));
 
     tprime = STimeRangeJustifyTime(t, kSTimeRangeJustifyTimeToHours, false);
-    printf("%lld %lld = %s\n", t, tprime, ctime(&tprime));
+    printf("%lld %lld = %s\n", (long long)t, (long long)tprime, ctime(&tprime));
 
     tprime = STimeRangeJustifyTime(t, kSTimeRangeJustifyTimeToDays, false);
-    printf("%lld %lld = %s\n", t, tprime, ctime(&tprime));
+    printf("%lld %lld = %s\n", (long long)t, (long long)tprime, ctime(&tprime));
 
     tprime = STimeRangeJustifyTime(t, kSTimeRangeJustifyTimeToMinutes, true);
-    printf("%lld %lld = %s\n", t, tprime, ctime(&tprime));
+    printf("%lld %lld = %s\n", (long long)t, (long long)tprime, ctime(&tprime));
 
     tprime = STimeRangeJustifyTime(t, kSTimeRangeJustifyTimeToHours, true);
-    printf("%lld %lld = %s\n", t, tprime, ctime(&tprime));
+    printf("%lld %lld = %s\n", (long long)t, (long long)tprime, ctime(&tprime));
 
     tprime = STimeRangeJustifyTime(t, kSTimeRangeJustifyTimeToDays, true);
-    printf("%lld %lld = %s\n", t, tprime, ctime(&tprime));
+    printf("%lld %lld = %s\n", (long long)t, (long long)tprime, ctime(&tprime));
 
     return 0;
 
@@ -16,6 +16,7 @@
  * Parse a date-time string with various possible formats:
  *
  *   - now, today, yesterday, tomorrow
+ *   - @<seconds since the epoch>
  *   - YYYYMMDDTHHMMSS±HHMM
  *   - YYYYMMDDTHHMMSS±HH
  *   - YYYYMMDDTHHMMSS
@@ -64,6 +65,12 @@ time_t STimeRangeJustifyTime(time_t theTime, STimeRangeJustifyTimeTo justifyTo,
  * @typedef STimeRangeRef
  *
  * Type of a reference to a STimeRange object.
+ *
+ * STimeRange objects are immutable once created.  When built with
+ * DTRMGR_ENABLE_ATOMIC_REFCOUNT (the default) a reference may be shared between
+ * threads and retained, released, and queried (STimeRangeGetCString() included)
+ * from any of them concurrently.  Otherwise all references to an object must be
+ * used from a single thread at a time.
  */
 typedef struct STimeRange const * STimeRangeRef;
 
@@ -121,6 +128,9 @@ STimeRangeRef STimeRangeCreateWithStartAndDuration(time_t start, time_t duration
  * representing that range.  If outEndPtr is not NULL, it is set to the address of the
  * character following the parsed portion of timeRangeStr.
  *
+ * Accepts the same forms as STimeRangeValueParse(), including the epoch form
+ * @<start>:@<end>.
+ *
  * @return A reference to an STimeRange object (possibly STimeRangeInvalid or
  *     STimeRangeInfinite) or NULL on a memory error.
  */
@@ -209,11 +219,25 @@ bool STimeRangeIsFullyBounded(STimeRangeRef aTimeRange);
  */
 bool STimeRangeGetDuration(STimeRangeRef aTimeRange, time_t *duration);
 
+/*!
+ * @defined STIMERANGE_CSTRING_MAX
+ *
+ * Size of a buffer large enough to hold any textual representation of a time
+ * range (two date-times of up to 21 characters -- the longest being an epoch
+ * form like @-9223372036854775808 -- a colon, and the NUL terminator).
+ */
+#define STIMERANGE_CSTRING_MAX      44
+
 /*!
  * @function STimeRangeGetCString
  *
  * Returns a pointer to a C string containing the textual representation
- * of aTimeRange.
+ * of aTimeRange.  The string is formatted on first request into a buffer
+ * inside aTimeRange, so no allocation is involved.
+ *
+ * When threads share aTimeRange, the first request formats the string.  A
+ * request made while that is under way waits (yielding the CPU) until the
+ * string is ready.  Once it is formatted, the call never waits.
  *
  * @return Pointer to a C string in a buffer owned by aTimeRange.
  */
@@ -411,8 +435,326 @@ unsigned int STimeRangeGetCountOfPeriodsOfLength(STimeRangeRef aTimeRange, time_
  *   start
  * - For aTimeRange with just an upper-bound, the 0th period occurs at the end
  *
+ * Each call allocates a new object; STimeRangePeriodGenerator yields the periods of a
+ * range by value instead.
+ *
  * @return A reference to an STimePeriod or NULL if no period exists at the given index.
  */
 STimeRangeRef STimeRangeGetPeriodOfLengthAtIndex(STimeRangeRef aTimeRange, time_t duration, unsigned int index);
 
+/*!
+ * @typedef STimeRangeValue
+ *
+ * A time range held by value rather than by reference.  STimeRangeValue needs no
+ * allocation, retain, or release, so it is the cheaper choice for intermediate
+ * results that are consumed right away; an STimeRange object need only be created
+ * (with STimeRangeCreateWithValue()) when the range must be shared or kept.
+ *
+ * The start and end fields are only meaningful if the corresponding bound flag is
+ * set in flags; an invalid range has no flags set.
+ */
+typedef struct STimeRangeValue {
+    time_t      start, end;
+    uint32_t    flags;
+} STimeRangeValue;
+
+/*!
+ * @enum STimeRangeValue flags
+ *
+ * @constant kSTimeRangeValueIsValid
+ *      The value represents a valid time range
+ * @constant kSTimeRangeValueHasLowerBound
+ *      The start field is set
+ * @constant kSTimeRangeValueHasUpperBound
+ *      The end field is set
+ */
+enum {
+    kSTimeRangeValueIsValid         = 1 << 2,
+    kSTimeRangeValueHasLowerBound   = 1 << 3,
+    kSTimeRangeValueHasUpperBound   = 1 << 4
+};
+
+/*!
+ * @constant STimeRangeValueInvalid
+ *
+ * An STimeRangeValue representing an invalid time range.
+ */
+extern const STimeRangeValue STimeRangeValueInvalid;
+
+/*!
+ * @constant STimeRangeValueInfinite
+ *
+ * An STimeRangeValue representing a time range with no lower or upper bound.
+ */
+extern const STimeRangeValue STimeRangeValueInfinite;
+
+/*!
+ * @function STimeRangeValueMake
+ *
+ * @return An STimeRangeValue with the given start and end timestamp, or
+ *    STimeRangeValueInvalid if end precedes start.
+ */
+STimeRangeValue STimeRangeValueMake(time_t start, time_t end);
+/*!
+ * @function STimeRangeValueMakeWithStart
+ *
+ * @return An STimeRangeValue with the given start timestamp and no upper bound.
+ */
+STimeRangeValue STimeRangeValueMakeWithStart(time_t start);
+/*!
+ * @function STimeRangeValueMakeWithEnd
+ *
+ * @return An STimeRangeValue with the given end timestamp and no lower bound.
+ */
+STimeRangeValue STimeRangeValueMakeWithEnd(time_t end);
+
+/*!
+ * @function STimeRangeGetValue
+ *
+ * @return The range represented by aTimeRange as an STimeRangeValue.
+ */
+STimeRangeValue STimeRangeGetValue(STimeRangeRef aTimeRange);
+/*!
+ * @function STimeRangeCreateWithValue
+ *
+ * Returns a reference to a STimeRange representing the same range as aValue.
+ *
+ * @return A reference to an STimeRange object (possibly STimeRangeInvalid or
+ *     STimeRangeInfinite) or NULL on a memory error.
+ */
+STimeRangeRef STimeRangeCreateWithValue(const STimeRangeValue *aValue);
+
+/*!
+ * @function STimeRangeValueIsValid
+ *
+ * @return Boolean true if aValue represents a valid time range, false otherwise.
+ */
+bool STimeRangeValueIsValid(const STimeRangeValue *aValue);
+/*!
+ * @function STimeRangeValueContainsTime
+ *
+ * @return Boolean true if theTime is in the range represented by aValue, false
+ *    otherwise.
+ */
+bool STimeRangeValueContainsTime(const STimeRangeValue *aValue, time_t theTime);
+/*!
+ * @function STimeRangeValueIsEqual
+ *
+ * @return Boolean true if the two ranges are the same, false otherwise.
+ */
+bool STimeRangeValueIsEqual(const STimeRangeValue *aValue, const STimeRangeValue *anotherValue);
+/*!
+ * @function STimeRangeValueDoesIntersect
+ *
+ * @return Boolean true if the two ranges overlap, false otherwise.
+ */
+bool STimeRangeValueDoesIntersect(const STimeRangeValue *aValue, const STimeRangeValue *anotherValue);
+/*!
+ * @function STimeRangeValueIsContained
+ *
+ * @return Boolean true if aValue is contained within inAnotherValue, false otherwise.
+ */
+bool STimeRangeValueIsContained(const STimeRangeValue *aValue, const STimeRangeValue *inAnotherValue);
+/*!
+ * @function STimeRangeValueIsContiguous
+ *
+ * @return Boolean true if the ranges do not intersect but occur one after the other
+ *    with no seconds between them, false otherwise.
+ */
+bool STimeRangeValueIsContiguous(const STimeRangeValue *aValue, const STimeRangeValue *anotherValue);
+/*!
+ * @function STimeRangeValueCmp
+ *
+ * Determine the ordering of two time ranges, as STimeRangeCmp().
+ *
+ * @return A negative integer if (lhs > rhs); zero if the two are equal; and a positive
+ *    integer if (lhs < rhs).
+ */
+int STimeRangeValueCmp(const STimeRangeValue *lhs, const STimeRangeValue *rhs);
+
+/*!
+ * @function STimeRangeValueIntersection
+ *
+ * @return The intersection of aValue and anotherValue, STimeRangeValueInvalid if the
+ *    two do not intersect.
+ */
+STimeRangeValue STimeRangeValueIntersection(const STimeRangeValue *aValue, const STimeRangeValue *anotherValue);
+/*!
+ * @function STimeRangeValueUnion
+ *
+ * @return The union of aValue and anotherValue, STimeRangeValueInvalid if the two do
+ *    not intersect.
+ */
+STimeRangeValue STimeRangeValueUnion(const STimeRangeValue *aValue, const STimeRangeValue *anotherValue);
+/*!
+ * @function STimeRangeValueJoin
+ *
+ * @return The range covered by aValue and anotherValue together, STimeRangeValueInvalid
+ *    if the two are not contiguous.
+ */
+STimeRangeValue STimeRangeValueJoin(const STimeRangeValue *aValue, const STimeRangeValue *anotherValue);
+/*!
+ * @function STimeRangeValueClip
+ *
+ * Narrow clipThis (in place) to the portion occuring inside toThis.  If the two do
+ * not intersect, clipThis is set to STimeRangeValueInvalid.
+ *
+ * @return Boolean true if any of clipThis remains, false otherwise.
+ */
+bool STimeRangeValueClip(STimeRangeValue *clipThis, const STimeRangeValue *toThis);
+/*!
+ * @function STimeRangeValueSplitAtTime
+ *
+ * Divide aValue into the portion before splitTime and the portion from splitTime
+ * onward.  Either portion may be STimeRangeValueInvalid if it would be empty.  Either
+ * of outLeading and outTrailing may be NULL.
+ *
+ * @return Boolean true if both portions are non-empty, false otherwise.
+ */
+bool STimeRangeValueSplitAtTime(const STimeRangeValue *aValue, time_t splitTime, STimeRangeValue *outLeading, STimeRangeValue *outTrailing);
+
+/*!
+ * @function STimeRangeValueGetCountOfPeriodsOfLength
+ *
+ * Determine the number of periods of length duration seconds contained in aValue,
+ * including one fractional-length period if duration does not cleanly divide the
+ * range.
+ *
+ * @return Zero for an invalid range or non-positive duration, UINT64_MAX for a range
+ *    not fully-bounded, a positive integer otherwise.
+ */
+uint64_t STimeRangeValueGetCountOfPeriodsOfLength(const STimeRangeValue *aValue, time_t duration);
+/*!
+ * @function STimeRangeValueGetPeriodOfLengthAtIndex
+ *
+ * Set outPeriod to the index-th period of length duration in aValue, counting from
+ * the start of the range or, if fromEnd is true, backward from the end.  The period
+ * at the far end of the range may be shorter than duration; a range lacking the far
+ * bound extends to the limit of time_t.
+ *
+ * @return Boolean false if aValue is invalid, lacks the bound counted from, or has
+ *    no period at index; true otherwise.
+ */
+bool STimeRangeValueGetPeriodOfLengthAtIndex(const STimeRangeValue *aValue, time_t duration, uint64_t index, bool fromEnd, STimeRangeValue *outPeriod);
+
+/*!
+ * @typedef STimeRangePeriodGenerator
+ *
+ * Yields the successive fixed-length periods of a range by value, without any
+ * allocation.  Initialize with STimeRangePeriodGeneratorInit() and call
+ * STimeRangePeriodGeneratorNext() until it returns false:
+ *
+ *     STimeRangePeriodGenerator    pieces;
+ *     STimeRangeValue              aPiece;
+ *
+ *     if ( STimeRangePeriodGeneratorInit(&pieces, &aValue, 60, false) ) {
+ *         while ( STimeRangePeriodGeneratorNext(&pieces, &aPiece) ) ...
+ *     }
+ *
+ * @field range
+ *      The range being divided
+ * @field duration
+ *      Length of each period in seconds
+ * @field nextIndex
+ *      Number of periods yielded so far
+ * @field isReverse
+ *      Whether periods are yielded backward from the end of the range
+ */
+typedef struct STimeRangePeriodGenerator {
+    STimeRangeValue     range;
+    time_t              duration;
+    uint64_t            nextIndex;
+    bool                isReverse;
+} STimeRangePeriodGenerator;
+
+/*!
+ * @function STimeRangePeriodGeneratorInit
+ *
+ * Prepare aGenerator to divide aValue into periods of length duration seconds,
+ * starting at its lower bound or, if isReverse is true, its upper bound.
+ *
+ * @return Boolean false (and aGenerator yields nothing) if aValue is invalid, lacks
+ *    the bound to start from, or duration is not positive; true otherwise.
+ */
+bool STimeRangePeriodGeneratorInit(STimeRangePeriodGenerator *aGenerator, const STimeRangeValue *aValue, time_t duration, bool isReverse);
+/*!
+ * @function STimeRangePeriodGeneratorNext
+ *
+ * Set outPeriod to the next period yielded by aGenerator.
+ *
+ * @return Boolean false once the range is exhausted, true otherwise.
+ */
+bool STimeRangePeriodGeneratorNext(STimeRangePeriodGenerator *aGenerator, STimeRangeValue *outPeriod);
+
+/*!
+ * @function STimeRangeValueParse
+ *
+ * Parse the given date-time range string into outValue.  If outEndPtr is not NULL, it
+ * is set to the address of the character following the parsed portion of
+ * timeRangeStr.
+ *
+ * Date-times in the canonical <YYYY><MM><DD>T<HH><MM><SS><±HHMM> format are decoded
+ * directly (honoring the UTC offset), as are date-times of the form @<seconds since
+ * the epoch> (e.g. @1577836800:@1577840399); anything else is handed to strptime()
+ * and interpreted as local time.
+ *
+ * @return Boolean true if a valid range was parsed, false otherwise (in which case
+ *    outValue is STimeRangeValueInvalid).
+ */
+bool STimeRangeValueParse(const char *timeRangeStr, STimeRangeValue *outValue, const char* *outEndPtr);
+/*!
+ * @function STimeRangeValueParseWithLength
+ *
+ * Equivalent to STimeRangeValueParse() for a timeRangeStr already known to be
+ * timeRangeLen bytes long (it must still be NUL-terminated).  A fully-bounded range
+ * in the canonical format is then decoded with SSE4.1 or AVX2 instructions if the CPU
+ * supports them.
+ */
+bool STimeRangeValueParseWithLength(const char *timeRangeStr, size_t timeRangeLen, STimeRangeValue *outValue, const char* *outEndPtr);
+
+/*!
+ * @function STimeRangeParseBuffer
+ *
+ * Parse the newline-separated date-time ranges in the bufferLen bytes at buffer (which
+ * need not be NUL-terminated) into outValues, which has room for *ioValueCount values.
+ * Whitespace around each range is ignored and blank lines are skipped; every other
+ * line must hold exactly one range in a form accepted by STimeRangeValueParse().
+ * Nothing is allocated.
+ *
+ * A line yields at most one value, so room for one more value than there are newlines
+ * in buffer is always sufficient.
+ *
+ * On return *ioValueCount is the number of values written to outValues.  If
+ * outErrorLine is not NULL, it is set to the (1-based) number of the line that could
+ * not be parsed or did not fit in outValues, or to zero if all of buffer was parsed.
+ *
+ * @return Boolean true if all of buffer was parsed, false otherwise.
+ */
+bool STimeRangeParseBuffer(const char *buffer, size_t bufferLen, STimeRangeValue *outValues, size_t *ioValueCount, size_t *outErrorLine);
+
+/*!
+ * @function STimeRangeValueFormat
+ *
+ * Write the textual representation of aValue (as STimeRangeGetCString()) to buffer,
+ * which is bufferSize bytes long.  A buffer of STIMERANGE_CSTRING_MAX bytes is always
+ * sufficient.
+ *
+ * @return The length of the string written to buffer, or zero if buffer was too
+ *    small.
+ */
+size_t STimeRangeValueFormat(const STimeRangeValue *aValue, char *buffer, size_t bufferSize);
+
+/*!
+ * @function STimeRangeValueFormatEpoch
+ *
+ * Write aValue to buffer (which is bufferSize bytes long) in the epoch form accepted by
+ * STimeRangeValueParse(), e.g. @1577836800:@1577840399.  No time zone conversion is
+ * involved.  An unbounded side is left empty (so an infinite range is written as a
+ * lone colon).  A buffer of STIMERANGE_CSTRING_MAX bytes is always sufficient.
+ *
+ * @return The length of the string written to buffer, or zero if buffer was too
+ *    small.
+ */
+size_t STimeRangeValueFormatEpoch(const STimeRangeValue *aValue, char *buffer, size_t bufferSize);
+
 #endif /* __STIMERANGE_H__ */
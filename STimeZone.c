@@ -0,0 +1,304 @@
+/*
+ *  STimeZone
+ *
+ *  Conversions between Unix timestamps and civil time in the local time zone
+ *
+ */
+
+#include "STimeZone.h"
+
+//
+
+int64_t
+__STimeZoneFloorDiv(
+    int64_t     numerator,
+    int64_t     denominator
+)
+{
+    int64_t     quotient = numerator / denominator;
+
+    if ( (numerator % denominator) && ((numerator < 0) != (denominator < 0)) ) quotient--;
+    return quotient;
+}
+
+//
+
+int64_t
+STimeZoneDaysFromCivil(
+    int64_t     year,
+    int         month,
+    int         day
+)
+{
+    //
+    // Days since 1970-01-01 in the proleptic Gregorian calendar (eras of 400
+    // years, each starting on March 1):
+    //
+    int64_t     era;
+    int64_t     yearOfEra, dayOfYear, dayOfEra;
+
+    if ( month <= 2 ) year--;
+    era = ( year >= 0 ? year : year - 399 ) / 400;
+    yearOfEra = year - era * 400;
+    dayOfYear = (153 * (month + ( month > 2 ? -3 : 9 )) + 2) / 5 + day - 1;
+    dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + dayOfEra - 719468;
+}
+
+//
+
+void
+STimeZoneCivilFromDays(
+    int64_t     days,
+    int64_t     *outYear,
+    int         *outMonth,
+    int         *outDay
+)
+{
+    //
+    // Inverse of STimeZoneDaysFromCivil():
+    //
+    int64_t     era, dayOfEra, yearOfEra, dayOfYear, monthIndex;
+
+    days += 719468;
+    era = ( days >= 0 ? days : days - 146096 ) / 146097;
+    dayOfEra = days - era * 146097;
+    yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    monthIndex = (5 * dayOfYear + 2) / 153;
+    *outDay = (int)(dayOfYear - (153 * monthIndex + 2) / 5 + 1);
+    *outMonth = (int)( monthIndex < 10 ? monthIndex + 3 : monthIndex - 9 );
+    *outYear = yearOfEra + era * 400 + ( *outMonth <= 2 );
+}
+
+//
+// Rather than calling localtime_r() for every conversion, the local time zone's
+// UTC offsets are cached per span of 2^STIMEZONE_OFFSET_SPAN_SHIFT seconds
+// (about 388 days):  the span is probed weekly and each change of offset pinned
+// down by bisection, so a span costs roughly 60 localtime_r() calls once and
+// nothing thereafter.  Offset changes that revert within a week would be missed;
+// no time zone has those.  Spans are cached per thread in a small direct-mapped
+// table, so lookups need no locking.
+//
+
+#ifndef STIMEZONE_OFFSET_CACHE_SIZE
+#define STIMEZONE_OFFSET_CACHE_SIZE 64
+#endif
+
+#define STIMEZONE_OFFSET_SPAN_SHIFT         25
+#define STIMEZONE_OFFSET_SPAN_LENGTH        ((int64_t)1 << STIMEZONE_OFFSET_SPAN_SHIFT)
+#define STIMEZONE_OFFSET_PROBE_INTERVAL     (7 * 86400)
+#define STIMEZONE_OFFSET_MAX_TRANSITIONS    8
+
+typedef struct __STimeZoneOffsetSpan {
+    bool            isValid;
+    int64_t         spanIndex;
+    unsigned int    transitionCount;
+    time_t          transitions[STIMEZONE_OFFSET_MAX_TRANSITIONS];
+    long            offsets[STIMEZONE_OFFSET_MAX_TRANSITIONS + 1];
+} __STimeZoneOffsetSpan;
+
+static _Thread_local __STimeZoneOffsetSpan __STimeZoneOffsetCache[STIMEZONE_OFFSET_CACHE_SIZE];
+
+bool
+__STimeZoneOffsetSpanFill(
+    __STimeZoneOffsetSpan   *aSpan,
+    int64_t                 spanIndex
+)
+{
+    time_t                  t = (time_t)(spanIndex * STIMEZONE_OFFSET_SPAN_LENGTH);
+    time_t                  spanEnd = t + (time_t)(STIMEZONE_OFFSET_SPAN_LENGTH - 1);
+    struct tm               components;
+    long                    offset;
+
+    aSpan->isValid = false;
+    if ( ! localtime_r(&t, &components) ) return false;
+    aSpan->spanIndex = spanIndex;
+    aSpan->transitionCount = 0;
+    aSpan->offsets[0] = offset = components.tm_gmtoff;
+    while ( t < spanEnd ) {
+        time_t              next = ( spanEnd - t > STIMEZONE_OFFSET_PROBE_INTERVAL ) ? t + STIMEZONE_OFFSET_PROBE_INTERVAL : spanEnd;
+
+        if ( ! localtime_r(&next, &components) ) return false;
+        if ( components.tm_gmtoff != offset ) {
+            //
+            // The offset changes somewhere in (t, next]; bisect to find the first
+            // second of the new offset:
+            //
+            time_t          lo = t, hi = next;
+
+            while ( hi - lo > 1 ) {
+                time_t      mid = lo + (hi - lo) / 2;
+
+                if ( ! localtime_r(&mid, &components) ) return false;
+                if ( components.tm_gmtoff == offset ) {
+                    lo = mid;
+                } else {
+                    hi = mid;
+                }
+            }
+            if ( (aSpan->transitionCount == STIMEZONE_OFFSET_MAX_TRANSITIONS) || ! localtime_r(&hi, &components) ) return false;
+            aSpan->transitions[aSpan->transitionCount++] = hi;
+            aSpan->offsets[aSpan->transitionCount] = offset = components.tm_gmtoff;
+            t = hi;
+        } else {
+            t = next;
+        }
+    }
+    aSpan->isValid = true;
+    return true;
+}
+
+//
+
+bool
+STimeZoneGetUTCOffset(
+    time_t          theTime,
+    long            *outOffset
+)
+{
+    int64_t                 spanIndex = __STimeZoneFloorDiv(theTime, STIMEZONE_OFFSET_SPAN_LENGTH);
+    __STimeZoneOffsetSpan   *aSpan = &__STimeZoneOffsetCache[(uint64_t)spanIndex % STIMEZONE_OFFSET_CACHE_SIZE];
+    unsigned int            i = 0;
+
+    if ( ! aSpan->isValid || (aSpan->spanIndex != spanIndex) ) {
+        if ( ! __STimeZoneOffsetSpanFill(aSpan, spanIndex) ) return false;
+    }
+    while ( (i < aSpan->transitionCount) && (theTime >= aSpan->transitions[i]) ) i++;
+    *outOffset = aSpan->offsets[i];
+    return true;
+}
+
+//
+
+bool
+__STimeZoneFindTransition(
+    time_t                  after,
+    time_t                  notAfter,
+    time_t                  *outTransition
+)
+{
+    //
+    // Locate the first cached transition in (after, notAfter]; the interval spans
+    // at most a couple of days, so at most two spans are consulted:
+    //
+    int64_t                 spanIndex = __STimeZoneFloorDiv(after, STIMEZONE_OFFSET_SPAN_LENGTH);
+    int64_t                 lastSpanIndex = __STimeZoneFloorDiv(notAfter, STIMEZONE_OFFSET_SPAN_LENGTH);
+    long                    offset;
+
+    while ( spanIndex <= lastSpanIndex ) {
+        __STimeZoneOffsetSpan   *aSpan = &__STimeZoneOffsetCache[(uint64_t)spanIndex % STIMEZONE_OFFSET_CACHE_SIZE];
+        unsigned int            i = 0;
+
+        if ( ! STimeZoneGetUTCOffset((time_t)(spanIndex * STIMEZONE_OFFSET_SPAN_LENGTH), &offset) ) return false;
+        while ( i < aSpan->transitionCount ) {
+            if ( (aSpan->transitions[i] > after) && (aSpan->transitions[i] <= notAfter) ) {
+                *outTransition = aSpan->transitions[i];
+                return true;
+            }
+            i++;
+        }
+        spanIndex++;
+    }
+    return false;
+}
+
+//
+
+void
+STimeZoneReset(void)
+{
+    unsigned int    i = 0;
+
+    tzset();
+    while ( i < STIMEZONE_OFFSET_CACHE_SIZE ) __STimeZoneOffsetCache[i++].isValid = false;
+}
+
+//
+
+bool
+STimeZoneTimeToCivil(
+    time_t              theTime,
+    STimeZoneCivilTime  *outCivilTime
+)
+{
+    long                offset;
+
+    if ( STimeZoneGetUTCOffset(theTime, &offset) ) {
+        int64_t         localTime = (int64_t)theTime + offset;
+        int64_t         days = __STimeZoneFloorDiv(localTime, 86400);
+        int64_t         secondOfDay = localTime - days * 86400;
+
+        STimeZoneCivilFromDays(days, &outCivilTime->year, &outCivilTime->month, &outCivilTime->day);
+        outCivilTime->hour = (int)(secondOfDay / 3600);
+        outCivilTime->minute = (int)((secondOfDay / 60) % 60);
+        outCivilTime->second = (int)(secondOfDay % 60);
+        outCivilTime->utcOffset = offset;
+        return true;
+    }
+    return false;
+}
+
+//
+
+bool
+STimeZoneCivilToTime(
+    const STimeZoneCivilTime    *civilTime,
+    time_t                      *outTime
+)
+{
+    int64_t                     monthIndex = (int64_t)civilTime->month - 1;
+    int64_t                     yearCarry = __STimeZoneFloorDiv(monthIndex, 12);
+    int64_t                     localTime;
+    long                        offsetBefore, offsetAfter, offset;
+
+    //
+    // Seconds since the epoch as if the local time zone were UTC; only the month
+    // needs normalizing before the days are counted, everything else is linear:
+    //
+    localTime = 86400 * (STimeZoneDaysFromCivil(civilTime->year + yearCarry, (int)(monthIndex - 12 * yearCarry) + 1, 1) + civilTime->day - 1)
+                    + 3600 * (int64_t)civilTime->hour + 60 * (int64_t)civilTime->minute + civilTime->second;
+
+    //
+    // No offset exceeds a day, so the offsets a day either side bracket any
+    // transition that could affect this civil time:
+    //
+    if ( ! STimeZoneGetUTCOffset((time_t)(localTime - 86400), &offsetBefore) ) return false;
+    if ( ! STimeZoneGetUTCOffset((time_t)(localTime + 86400), &offsetAfter) ) return false;
+    if ( offsetBefore == offsetAfter ) {
+        *outTime = (time_t)(localTime - offsetBefore);
+        return true;
+    }
+
+    bool                        isBeforeValid, isAfterValid;
+
+    if ( ! STimeZoneGetUTCOffset((time_t)(localTime - offsetBefore), &offset) ) return false;
+    isBeforeValid = (offset == offsetBefore);
+    if ( ! STimeZoneGetUTCOffset((time_t)(localTime - offsetAfter), &offset) ) return false;
+    isAfterValid = (offset == offsetAfter);
+
+    if ( isBeforeValid && isAfterValid ) {
+        //
+        // Clocks were set back, the civil time happened twice:
+        //
+        if ( civilTime->utcOffset == offsetAfter ) {
+            offset = offsetAfter;
+        } else if ( civilTime->utcOffset == offsetBefore ) {
+            offset = offsetBefore;
+        } else {
+            offset = ( offsetBefore > offsetAfter ) ? offsetBefore : offsetAfter;
+        }
+    } else if ( isAfterValid ) {
+        offset = offsetAfter;
+    } else if ( isBeforeValid ) {
+        offset = offsetBefore;
+    } else {
+        //
+        // Clocks were set forward over the civil time, so it never happened; the
+        // transition itself is the first instant with a later civil time:
+        //
+        return __STimeZoneFindTransition((time_t)(localTime - offsetAfter), (time_t)(localTime - offsetBefore), outTime);
+    }
+    *outTime = (time_t)(localTime - offset);
+    return true;
+}
@@ -0,0 +1,114 @@
+/*
+ *  STimeZone
+ *
+ *  Conversions between Unix timestamps and civil time in the local time zone
+ *
+ */
+
+#ifndef __STIMEZONE_H__
+#define __STIMEZONE_H__
+
+#include "config.h"
+
+/*!
+ * @typedef STimeZoneCivilTime
+ *
+ * A broken-down civil time in the local time zone.
+ *
+ * @field year
+ *      Proleptic Gregorian year (e.g. 2024)
+ * @field month
+ *      Month of the year, 1 through 12
+ * @field day
+ *      Day of the month, 1 through 31
+ * @field hour
+ *      Hour of the day, 0 through 23
+ * @field minute
+ *      Minute of the hour, 0 through 59
+ * @field second
+ *      Second of the minute, 0 through 60
+ * @field utcOffset
+ *      Seconds east of UTC in effect at this civil time
+ */
+typedef struct STimeZoneCivilTime {
+    int64_t     year;
+    int         month, day;
+    int         hour, minute, second;
+    long        utcOffset;
+} STimeZoneCivilTime;
+
+/*!
+ * @defined STIMEZONE_NO_OFFSET_HINT
+ *
+ * Value of STimeZoneCivilTime.utcOffset which expresses no preference when
+ * STimeZoneCivilToTime() resolves an ambiguous civil time.
+ */
+#define STIMEZONE_NO_OFFSET_HINT    LONG_MIN
+
+/*!
+ * @function STimeZoneDaysFromCivil
+ *
+ * Returns the number of days between 1970-01-01 and the given date in the
+ * proleptic Gregorian calendar.  The month must be in the range 1 through 12;
+ * day may be any value (it is added linearly).
+ */
+int64_t STimeZoneDaysFromCivil(int64_t year, int month, int day);
+
+/*!
+ * @function STimeZoneCivilFromDays
+ *
+ * Inverse of STimeZoneDaysFromCivil():  sets outYear, outMonth, and outDay to the
+ * date which is days after 1970-01-01.
+ */
+void STimeZoneCivilFromDays(int64_t days, int64_t *outYear, int *outMonth, int *outDay);
+
+/*!
+ * @function STimeZoneGetUTCOffset
+ *
+ * Determine the local time zone's offset from UTC (in seconds east) at theTime.
+ *
+ * The local time zone's transitions are cached per thread, so after the first
+ * lookup in a given year of timestamps no C library calls are involved.
+ *
+ * @return Boolean true if successful, false otherwise.
+ */
+bool STimeZoneGetUTCOffset(time_t theTime, long *outOffset);
+
+/*!
+ * @function STimeZoneReset
+ *
+ * Re-read the local time zone (via tzset()) and discard the calling thread's cached
+ * transitions.  Only needed if the TZ environment variable is changed after the
+ * first conversion.
+ */
+void STimeZoneReset(void);
+
+/*!
+ * @function STimeZoneTimeToCivil
+ *
+ * Break theTime down into civil time in the local time zone (the equivalent of
+ * localtime_r()).
+ *
+ * @return Boolean true if successful, false otherwise.
+ */
+bool STimeZoneTimeToCivil(time_t theTime, STimeZoneCivilTime *outCivilTime);
+
+/*!
+ * @function STimeZoneCivilToTime
+ *
+ * Convert civilTime in the local time zone to a Unix timestamp (the equivalent
+ * of mktime()).  Fields outside their normal ranges are normalized, so e.g. an
+ * hour of 24 denotes midnight of the following day.
+ *
+ * Civil times which do not exist because the clocks were set forward resolve to
+ * the transition, the first instant with a later civil time (so 02:30 on a day
+ * the clocks skip from 02:00 to 03:00 yields 03:00).
+ * Civil times which occur twice because the clocks were set back resolve to the
+ * occurrence whose offset matches civilTime->utcOffset, or to the earlier one
+ * if it matches neither (e.g. STIMEZONE_NO_OFFSET_HINT).
+ *
+ * @return Boolean true if successful, false otherwise.
+ */
+bool STimeZoneCivilToTime(const STimeZoneCivilTime *civilTime, time_t *outTime);
+
+#endif /* __STIMEZONE_H__ */
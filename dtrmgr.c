@@ -66,14 +66,16 @@ const struct option cliOptions[] = {
             { "load",           required_argument,  NULL,       'l' },
             { "save",           optional_argument,  NULL,       's' },
             { "print",          no_argument,        NULL,       'p' },
+            { "epoch",          no_argument,        NULL,       'e' },
             { "before",         required_argument,  NULL,       'b' },
             { "duration",       required_argument,  NULL,       'd' },
             { "next",           required_argument,  NULL,       'n' },
             { "add-range",      required_argument,  NULL,       'a' },
             { "add-file",       required_argument,  NULL,       'f' },
+            { "remove-range",   required_argument,  NULL,       'r' },
             { NULL,             0,                  NULL,       0   }
         };
-const char *cliOptionsStr = "hi:l:s::pb:d:n:a:f:";
+const char *cliOptionsStr = "hi:l:s::peb:d:n:a:f:r:";
 
 //
 
@@ -96,6 +98,7 @@ usage(
             "    --save{=<file>}, -s{<file>}            save the working schedule; if a <file> is not\n"
             "                                           specified, the origin file is used\n"
             "    -p/--print                             summarize the working schedule to stdout\n"
+            "    -e/--epoch                             display generated time blocks as @<epoch>:@<epoch>\n"
             "\n"
             "   working schedule modification options:\n"
             "\n"
@@ -107,11 +110,13 @@ usage(
             "    --add-range=<range>, -a <range>        add a scheduled time range to the working schedule\n"
             "    --add-file=<file>, -f <file>           add time range(s) read from the given file to the\n"
             "                                           working schedule\n"
+            "    --remove-range=<range>, -r <range>     remove a time range from the working schedule\n"
             "\n"
-            "  <date-time> :: a date and time in a variety of formats (as recognized by getdate)\n"
+            "  <date-time> :: a date and time in a variety of formats (as recognized by getdate) or @<epoch>\n"
             "  <dur> :: <integer>{<unit>} | <day>-<hr>{:<min>{:<sec>}} | {<hr>:{<min>:}}<sec>\n"
             "  <unit> :: d{ay{s}} | h{our{s}} | hr{s} | m{in{ute}{s}} | s{ec{ond}{s}}\n"
             "  <range> :: {<YYYY><MM><DD>T<HH><MM><SS><±HHMM>}:{<YYYY><MM><DD>T<HH><MM><SS><±HHMM>}\n"
+            "           | {@<epoch>}:{@<epoch>}\n"
             "\n",
             exe,
             dtrmgrDefaultDuration
@@ -119,42 +124,66 @@ usage(
 }
 
 /*!
- * @function fgetline
+ * @function freadall
  *
- * Read a single <NL>-terminated line of characters from fptr and return
- * a pointer to a buffer owned by this function that contains the line as a
- * C string (sans <NL>).
+ * Read everything remaining in fptr into a single buffer and return it (the caller
+ * must free() the buffer).  The number of bytes read is returned in bufferLen.
  */
-const char*
-fgetline(
+char*
+freadall(
     FILE    *fptr,
-    size_t  *lineLen
+    size_t  *bufferLen
 )
 {
-    static char     *fgetline_buffer = NULL;
-    static size_t   fgetline_buffer_size = 0;
+    char    *buffer = NULL;
+    size_t  buffer_size = 0, i = 0, n;
     
-    size_t          i = 0;
-    int             c;
-    
-    while ( (c = fgetc(fptr)) != EOF ) {
-        if ( c == '\n' ) break;
-        if ( i + 1 > fgetline_buffer_size ) {
-            size_t  new_buffer_len = 4096 * ((fgetline_buffer_size / 4096) + 1);
-            char    *new_buffer = realloc(fgetline_buffer, new_buffer_len);
+    do {
+        if ( i == buffer_size ) {
+            size_t  new_buffer_size = buffer_size ? 2 * buffer_size : 65536;
+            char    *new_buffer = realloc(buffer, new_buffer_size);
             
             if ( ! new_buffer ) {
-                fprintf(stderr, "FATAL:  unable to resize fgetline() input buffer\n");
+                fprintf(stderr, "FATAL:  unable to resize freadall() input buffer\n");
                 exit(ENOMEM);
             }
-            fgetline_buffer = new_buffer;
-            fgetline_buffer_size = new_buffer_len;
+            buffer = new_buffer;
+            buffer_size = new_buffer_size;
         }
-        fgetline_buffer[i++] = c;
+        i += (n = fread(buffer + i, 1, buffer_size - i, fptr));
+    } while ( n > 0 );
+    *bufferLen = i;
+    return buffer;
+}
+
+//
+
+/*!
+ * @function dtrmgrPrintAllocatedBlock
+ *
+ * Callback for SScheduleAllocateNext() that writes each newly-allocated block of
+ * time to stdout.  If context points to a true bool, the block is written in the
+ * epoch form.
+ */
+bool
+dtrmgrPrintAllocatedBlock(
+    SScheduleRef    aSchedule,
+    time_t          start,
+    time_t          end,
+    void            *context
+)
+{
+    STimeRangeValue subRange = STimeRangeValueMake(start, end);
+    char            subRangeStr[STIMERANGE_CSTRING_MAX];
+    
+    (void)aSchedule;
+    if ( context && *((bool*)context) ) {
+        STimeRangeValueFormatEpoch(&subRange, subRangeStr, sizeof(subRangeStr));
+    } else {
+        STimeRangeValueFormat(&subRange, subRangeStr, sizeof(subRangeStr));
     }
-    if ( lineLen ) *lineLen = i;
-    fgetline_buffer[i] = '\0';
-    return (const char*)fgetline_buffer;
+    printf("%s\n", subRangeStr);
+    return true;
 }
 
 //
@@ -171,6 +200,7 @@ main(
     time_t                      duration = (time_t)dtrmgrDefaultDuration;
     time_t                      beforeTime = time(NULL);
     STimeRangeJustifyTimeTo     justify = dtrmgrDefaultJustify;
+    bool                        shouldPrintEpoch = false;
     int                         optc;
     
     while ( (optc = getopt_long(argc, argv, cliOptionsStr, cliOptions, NULL)) != -1 ) {
@@ -236,7 +266,12 @@ main(
                 if ( theSchedule ) SScheduleSummarize(theSchedule, stdout);
                 break;
             }
-            
+
+            case 'e': {
+                shouldPrintEpoch = true;
+                break;
+            }
+
             case 'b': {
                 if ( ! STimeRangeParseDateAndTime(optarg, &beforeTime) ) {
                     fprintf(stderr, "ERROR:  invalid date/time provided with --before/-b: %s\n", optarg);
@@ -334,41 +369,7 @@ main(
                         fprintf(stderr, "ERROR:  no working schedule\n");
                         exit(EINVAL);
                     }
-                    if ( ! SScheduleIsFull(theSchedule) ) {
-                        time_t              beforeTimeAdj = STimeRangeJustifyTime(beforeTime, justify, false);
-                        
-                        while ( N > 0 ) {
-                            STimeRangeRef   nextBlock = SScheduleGetNextOpenBlockBeforeTime(theSchedule, beforeTimeAdj);
-                            
-                            if ( ! nextBlock ) break;
-                            //
-                            // How many blocks of size duration is that?
-                            //
-                            unsigned int        nPeriods = STimeRangeGetCountOfPeriodsOfLength(nextBlock, duration);
-                            
-                            if ( nPeriods > 0 ) {
-                                unsigned int    iPeriod = 0;
-                                
-                                while ( (N > 0) && (iPeriod < nPeriods) ) {
-                                    STimeRangeRef   subRange = STimeRangeGetPeriodOfLengthAtIndex(nextBlock, duration, iPeriod++);
-                                    
-                                    if ( ! subRange ) {
-                                        fprintf(stderr, "ERROR:  unable to allocate scheduling sub-range\n");
-                                        exit(ENOMEM);
-                                    }
-                                    printf("%s\n", STimeRangeGetCString(subRange));
-                                    SScheduleAddScheduledBlock(theSchedule, subRange);
-                                    STimeRangeRelease(subRange);
-                                    N--;
-                                }
-                            } else {
-                                printf("%s\n", STimeRangeGetCString(nextBlock));
-                                SScheduleAddScheduledBlock(theSchedule, nextBlock);
-                                N--;
-                            }
-                            STimeRangeRelease(nextBlock);
-                        }
-                    }
+                    SScheduleAllocateNext(theSchedule, duration, STimeRangeJustifyTime(beforeTime, justify, false), (N > UINT_MAX) ? UINT_MAX : N, dtrmgrPrintAllocatedBlock, &shouldPrintEpoch);
                 } else {
                     fprintf(stderr, "ERROR:  invalid block count provided with --next/-n: %s\n", optarg);
                     exit(EINVAL);
@@ -414,29 +415,67 @@ main(
                     }
                 }
                 //
-                // Process time ranges in a loop:
+                // Read the whole file, parse all time ranges, and then add them in one go:
                 //
-                const char  *nextRangeStr;
+                size_t          inputLen, rangeCount = 1, errorLine;
+                char            *input = freadall(inputFPtr, &inputLen);
+                const char      *p = input, *inputEnd = input + inputLen;
+                STimeRangeValue *ranges;
+                
+                if ( ferror(inputFPtr) ) {
+                    fprintf(stderr, "ERROR:  unable to read time ranges from file: %s\n", optarg);
+                    exit(EIO);
+                }
+                if ( closeWhenDone ) fclose(inputFPtr);
+                while ( (p = memchr(p, '\n', inputEnd - p)) ) p++, rangeCount++;
+                if ( ! (ranges = malloc(rangeCount * sizeof(STimeRangeValue))) ) {
+                    fprintf(stderr, "FATAL:  unable to allocate time range list\n");
+                    exit(ENOMEM);
+                }
+                if ( ! STimeRangeParseBuffer(input, inputLen, ranges, &rangeCount, &errorLine) ) {
+                    fprintf(stderr, "ERROR:  invalid time range string for addition at line %zu of %s\n", errorLine, optarg);
+                    exit(EINVAL);
+                }
+                free((void*)input);
+                if ( rangeCount > UINT_MAX ) {
+                    fprintf(stderr, "ERROR:  too many time ranges in file: %s\n", optarg);
+                    exit(EINVAL);
+                }
+                if ( ! SScheduleAddScheduledBlockValues(theSchedule, ranges, (unsigned int)rangeCount) ) {
+                    fprintf(stderr, "FATAL:  unable to add time ranges to working schedule\n");
+                    exit(ENOMEM);
+                }
+                free((void*)ranges);
+                break;
+            }
             
-                while ( ! feof(inputFPtr) && (nextRangeStr = fgetline(inputFPtr, NULL)) ) {
-                    while ( isspace(*nextRangeStr) ) nextRangeStr++;
-                    if ( *nextRangeStr ) {
-                        STimeRangeRef   nextRange = STimeRangeCreateWithString(nextRangeStr, NULL);
+            case 'r': {
+                if ( ! theSchedule ) {
+                    fprintf(stderr, "ERROR:  no working schedule\n");
+                    exit(EINVAL);
+                }
                 
-                        if ( nextRange && STimeRangeIsValid(nextRange) ) {
-                            SScheduleAddScheduledBlock(theSchedule, nextRange);
-                            STimeRangeRelease(nextRange);
-                        } else {
-                            fprintf(stderr, "ERROR:  invalid time range string for addition: %s\n", nextRangeStr);
-                            exit(EINVAL);
-                        }
+                STimeRangeRef   nextRange = STimeRangeCreateWithString(optarg, NULL);
+                
+                if ( nextRange && STimeRangeIsValid(nextRange) ) {
+                    if ( ! SScheduleRemoveScheduledBlock(theSchedule, nextRange) ) {
+                        fprintf(stderr, "FATAL:  unable to remove time range from working schedule\n");
+                        exit(ENOMEM);
                     }
+                    STimeRangeRelease(nextRange);
+                } else {
+                    fprintf(stderr, "ERROR:  invalid time range string for removal: %s\n", optarg);
+                    exit(EINVAL);
                 }
-                if ( closeWhenDone ) fclose(inputFPtr);
                 break;
-            }            
+            }
         }
     }
     
+    //
+    // Releasing the working schedule closes its database connection, which folds
+    // the write-ahead log back into the file:
+    //
+    if ( theSchedule ) SScheduleRelease(theSchedule);
     return 0;
 }
\ No newline at end of file